@@ -0,0 +1,560 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "delaunay.h"
+#include "parallel.h"
+#include "snapshot.h"
+#include "stream.h"
+#include "voronoi.h"
+#include "weld.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  double seconds_since(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  // Peak resident set in kilobytes, 0 where unsupported.
+  long peak_rss_kb() {
+#if defined(__linux__)
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+#elif defined(__APPLE__)
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss / 1024;
+#else
+    return 0;
+#endif
+  }
+
+  // Uniform points in a square.
+  std::vector<float> uniform_points(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> coord(-5.0f, 5.0f);
+    std::vector<float> pts(2 * n);
+    for (auto& p : pts) p = coord(rng);
+    return pts;
+  }
+
+  const char* name(delaunay::Locate locate) {
+    return locate == delaunay::Locate::walk ? "walk" : "history";
+  }
+
+  const char* name(const delaunay::Options& options) {
+    if (options.m_engine == delaunay::Engine::divide) return "divide";
+    if (options.m_kernel == delaunay::Kernel::cavity) return "brio/hilbert/cavity";
+    if (options.m_order == delaunay::Order::shuffle) return name(options.m_locate);
+    if (options.m_locate == delaunay::Locate::walk) {
+      return options.m_curve == delaunay::Curve::hilbert ? "brio/hilbert/walk" : "brio/morton/walk";
+    }
+    return options.m_curve == delaunay::Curve::hilbert ? "brio/hilbert/history" : "brio/morton/history";
+  }
+
+  void bench_build(size_t n, const delaunay::Options& options) {
+    std::vector<float> pts = uniform_points(n, 1);
+
+    Clock::time_point start = Clock::now();
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+    double build = seconds_since(start);
+
+    printf("build     %-20s n=%-9zu %8.3fs  %7.1f bytes/point  rss %ldKB\n",
+      name(options), n, build, static_cast<double>(tria->bytes()) / n, peak_rss_kb());
+    delete tria;
+  }
+
+  template <typename Traits>
+  void bench_traits(const char* label, const std::vector<typename Traits::Scalar>& pts) {
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    options.m_locate = delaunay::Locate::walk;
+    size_t n = pts.size() / 2;
+    Clock::time_point start = Clock::now();
+    delaunay::BasicTriangulation<Traits>* tria = delaunay::triangulate<Traits>(pts.data(), n, 2 * sizeof(pts[0]), options);
+    double build = seconds_since(start);
+
+    printf("traits    %-20s n=%-9zu %8.3fs  %7.1f bytes/point\n",
+      label, n, build, static_cast<double>(tria->bytes()) / n);
+    delete tria;
+  }
+
+  // The same points under each built in traits, the double ones moved out
+  // to UTM like coordinates where float would merge neighbors and the int
+  // ones snapped to a grid of 10^-5.
+  void bench_traits(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    bench_traits<delaunay::FloatTraits>("float", pts);
+    bench_traits<delaunay::FastFloatTraits>("float/fast", pts);
+    std::vector<double> utm(pts.size());
+    for (size_t i = 0; i < n; ++i) {
+      utm[2 * i] = 500000.0 + 1000.0 * pts[2 * i];
+      utm[2 * i + 1] = 4650000.0 + 1000.0 * pts[2 * i + 1];
+    }
+    bench_traits<delaunay::DoubleTraits>("double/utm", utm);
+    std::vector<int32_t> grid(pts.size());
+    for (size_t i = 0; i < pts.size(); ++i) grid[i] = static_cast<int32_t>(lround(pts[i] * 100000.0));
+    bench_traits<delaunay::IntTraits>("int32/grid", grid);
+  }
+
+  // Builds straight from an interleaved x, y, z buffer like the demo keeps.
+  void bench_ingest(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    std::vector<float> xyz(3 * n);
+    for (size_t i = 0; i < n; ++i) {
+      xyz[3 * i] = pts[2 * i];
+      xyz[3 * i + 1] = pts[2 * i + 1];
+    }
+
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    options.m_locate = delaunay::Locate::walk;
+    Clock::time_point start = Clock::now();
+    delaunay::Triangulation* tria = delaunay::triangulate(xyz.data(), n, 3 * sizeof(float), options);
+    double build = seconds_since(start);
+
+    printf("ingest    xyz      n=%-9zu %8.3fs  %7.1f bytes/point  rss %ldKB\n",
+      n, build, static_cast<double>(tria->bytes()) / n, peak_rss_kb());
+    delete tria;
+  }
+
+  // Exporting the leaves into a fresh vector and into a reused buffer.
+  void bench_export(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    options.m_locate = delaunay::Locate::walk;
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+
+    Clock::time_point start = Clock::now();
+    std::vector<float> tris = tria->get_tris();
+    double fresh = seconds_since(start);
+
+    start = Clock::now();
+    tria->get_tris(tris.data());
+    double reused = seconds_since(start);
+
+    // The indexed mesh, a third of the floats' size plus the shared vertices.
+    std::vector<uint32_t> indices(3 * tria->triangle_count());
+    start = Clock::now();
+    tria->get_indices(indices.data());
+    double indexed = seconds_since(start);
+
+    printf("export    n=%-9zu tris=%-9zu vector %8.4fs  buffer %8.4fs  indices %8.4fs\n",
+      n, tria->triangle_count(), fresh, reused, indexed);
+    delete tria;
+  }
+
+  // Random queries, then the same queries sorted into rows so consecutive
+  // ones are close together.
+  void bench_find(size_t n, delaunay::Locate locate) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    options.m_locate = locate;
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+
+    std::vector<float> queries = uniform_points(n, 2);
+    std::vector<delaunay::Point> random, coherent;
+    for (size_t i = 0; i < queries.size(); i += 2) {
+      random.push_back(delaunay::Point(queries[i], queries[i + 1]));
+    }
+    coherent = random;
+    std::sort(coherent.begin(), coherent.end(),
+      [](const delaunay::Point& a, const delaunay::Point& b) {
+        int ra = static_cast<int>(a.y * 10.0f), rb = static_cast<int>(b.y * 10.0f);
+        return ra != rb ? ra < rb : ((ra & 1) ? a.x > b.x : a.x < b.x);
+      });
+
+    std::vector<delaunay::TriNode*> nodes;
+    for (auto* order : { &random, &coherent }) {
+      Clock::time_point start = Clock::now();
+      for (const auto& q : *order) {
+        nodes.clear();
+        tria->find(q, nodes);
+      }
+      double elapsed = seconds_since(start);
+      printf("find      %-8s n=%-9zu %-8s %10.0f queries/s\n", name(locate), n,
+        order == &random ? "random" : "coherent", order->size() / elapsed);
+    }
+    delete tria;
+  }
+
+  // Points fed one at a time into a persistent triangulation, the way the
+  // demo and streaming sources add them.
+  void bench_insert(size_t n, delaunay::Locate locate) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Triangulation tria;
+    tria.set_locate(locate);
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < pts.size(); i += 2) {
+      tria.insert(delaunay::Point(pts[i], pts[i + 1]));
+    }
+    double elapsed = seconds_since(start);
+    printf("insert    %-8s n=%-9zu %8.3fs %10.0f points/s\n", name(locate), n,
+      elapsed, n / elapsed);
+  }
+
+  // Frames of every point drifting a little, updated in place against a
+  // rebuild from scratch.
+  void bench_move(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_engine = delaunay::Engine::divide;
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+
+    // Ids follow the order the engine took the points in.
+    std::vector<delaunay::Point> positions = tria->get_vertices();
+    std::vector<uint32_t> ids(positions.size());
+    for (size_t i = 0; i < ids.size(); ++i) ids[i] = static_cast<uint32_t>(i);
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> step(-0.002f, 0.002f);
+    const int frames = 10;
+    double update = 0, rebuild = 0;
+    size_t moved = 0;
+    size_t bytes = tria->bytes();
+    for (int frame = 0; frame < frames; ++frame) {
+      for (auto& p : positions) p = delaunay::Point(p.x + step(rng), p.y + step(rng));
+
+      Clock::time_point start = Clock::now();
+      moved += tria->move_vertices(ids.data(), positions.data(), ids.size());
+      update += seconds_since(start);
+
+      start = Clock::now();
+      delete delaunay::triangulate(&positions[0].x, positions.size(), sizeof(delaunay::Point), options);
+      rebuild += seconds_since(start);
+    }
+    printf("move      n=%-9zu update %8.4fs  rebuild %8.4fs per frame  moved %5.2f%%  %zu -> %zu bytes\n", n,
+      update / frames, rebuild / frames, 100.0 * moved / (frames * ids.size()), bytes, tria->bytes());
+    delete tria;
+  }
+
+  // Horizontal polylines, like contours or roads, forced into a
+  // triangulation of uniform points piece by piece.
+  void bench_constrain(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Triangulation* tria = delaunay::triangulate(pts);
+
+    // About four triangles to a piece and a quarter as many pieces as
+    // points.
+    float piece = 4.0f * 10.0f / static_cast<float>(sqrt(static_cast<double>(n)));
+    size_t per_line = static_cast<size_t>(10.0f / piece);
+    size_t lines = std::max<size_t>(1, n / 4 / per_line);
+    std::vector<uint32_t> ends;
+    for (size_t i = 0; i < lines; ++i) {
+      float y = -5.0f + 10.0f * (i + 0.5f) / lines;
+      uint32_t previous = delaunay::no_vertex;
+      for (size_t j = 0; j <= per_line; ++j) {
+        uint32_t id = tria->insert(delaunay::Point(-5.0f + piece * j, y));
+        if (id != delaunay::no_vertex && previous != delaunay::no_vertex) {
+          ends.push_back(previous);
+          ends.push_back(id);
+        }
+        previous = id;
+      }
+    }
+
+    Clock::time_point start = Clock::now();
+    size_t inserted = tria->insert_segments(ends.data(), ends.size() / 2);
+    double elapsed = seconds_since(start);
+    printf("constrain n=%-9zu segments=%-9zu %8.3fs %10.0f segments/s  failed=%zu\n", n, inserted,
+      elapsed, inserted / elapsed, tria->validate());
+    delete tria;
+  }
+
+  // Every Voronoi cell clipped to the square the points are in.
+  void bench_voronoi(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_engine = delaunay::Engine::divide;
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+
+    delaunay::Voronoi cells;
+    Clock::time_point start = Clock::now();
+    delaunay::voronoi(*tria, delaunay::Point(-5.0f, -5.0f), delaunay::Point(5.0f, 5.0f), 0, cells);
+    double elapsed = seconds_since(start);
+    printf("voronoi   n=%-9zu %8.3fs  corners=%zu\n", n, elapsed, cells.m_x.size());
+    delete tria;
+  }
+
+  // find_batch over n random points, on one thread and on all of them.
+  void bench_find_batch(size_t n, delaunay::Locate locate) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    options.m_locate = locate;
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+
+    std::vector<float> queries = uniform_points(n, 2);
+    std::vector<uint32_t> triangles(n);
+    for (unsigned threads : { 1u, 0u }) {
+      Clock::time_point start = Clock::now();
+      tria->find_batch(queries.data(), n, triangles.data(), threads);
+      double elapsed = seconds_since(start);
+      printf("batch     %-8s n=%-9zu threads=%-3u %10.0f queries/s\n", name(locate), n,
+        delaunay::thread_count(threads), n / elapsed);
+    }
+    delete tria;
+  }
+
+  // Scans where every location is hit three times on average, some exactly
+  // and some within the tolerance, built with and without welding first.
+  void bench_weld(size_t n) {
+    std::vector<float> base = uniform_points(n / 3, 1);
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> jitter(-0.0004f, 0.0004f);
+    std::vector<float> pts(2 * n);
+    for (size_t i = 0; i < n; ++i) {
+      size_t k = rng() % (base.size() / 2);
+      bool exact = rng() % 2;
+      pts[2 * i] = base[2 * k] + (exact ? 0.0f : jitter(rng));
+      pts[2 * i + 1] = base[2 * k + 1] + (exact ? 0.0f : jitter(rng));
+    }
+
+    std::vector<uint32_t> remap;
+    Clock::time_point start = Clock::now();
+    size_t kept = delaunay::weld(pts.data(), n, 2 * sizeof(float), delaunay::FloatTraits::tolerance(), remap);
+    double weld = seconds_since(start);
+
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    double build[2];
+    for (int w = 0; w < 2; ++w) {
+      options.m_weld = w == 1;
+      start = Clock::now();
+      delete delaunay::triangulate(pts, options);
+      build[w] = seconds_since(start);
+    }
+
+    printf("weld      n=%-9zu kept %-9zu %8.3fs  build %8.3fs  welded build %8.3fs\n",
+      n, kept, weld, build[0], build[1]);
+  }
+
+  // Memory and random find speed before and after compact, which trades
+  // the history for a walk started from a grid.
+  void bench_compact(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+
+    std::vector<float> xy = uniform_points(n, 2);
+    std::vector<delaunay::Point> queries(n);
+    for (size_t i = 0; i < n; ++i) queries[i] = delaunay::Point(xy[2 * i], xy[2 * i + 1]);
+
+    double bytes[2];
+    double found[2];
+    double elapsed = 0;
+    std::vector<delaunay::TriNode*> nodes;
+    for (int c = 0; c < 2; ++c) {
+      if (c) {
+        Clock::time_point start = Clock::now();
+        tria->compact();
+        elapsed = seconds_since(start);
+      }
+      bytes[c] = static_cast<double>(tria->bytes()) / n;
+      Clock::time_point start = Clock::now();
+      for (const auto& q : queries) {
+        nodes.clear();
+        tria->find(q, nodes);
+      }
+      found[c] = n / seconds_since(start);
+    }
+
+    printf("compact   n=%-9zu %8.3fs  %6.1f -> %6.1f bytes/point  find %10.0f -> %10.0f queries/s\n",
+      n, elapsed, bytes[0], bytes[1], found[0], found[1]);
+    delete tria;
+  }
+
+  // Writing a compacted triangulation out, then mapping it back and
+  // querying it in place, against building it again.
+  void bench_snapshot(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    options.m_locate = delaunay::Locate::walk;
+    Clock::time_point start = Clock::now();
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+    double build = seconds_since(start);
+    tria->compact();
+
+    const char* path = "delaunay_bench.snapshot";
+    start = Clock::now();
+    bool written = delaunay::write_snapshot(*tria, path);
+    double write = seconds_since(start);
+    delete tria;
+    if (!written) {
+      printf("snapshot  n=%-9zu can't write %s\n", n, path);
+      return;
+    }
+
+    std::vector<float> xy = uniform_points(n, 2);
+    std::vector<delaunay::Point> queries(n);
+    for (size_t i = 0; i < n; ++i) queries[i] = delaunay::Point(xy[2 * i], xy[2 * i + 1]);
+
+    // Opening and the first query, which faults in the pages it touches.
+    delaunay::Snapshot snapshot;
+    start = Clock::now();
+    snapshot.open(path);
+    snapshot.find(queries[0]);
+    double open = seconds_since(start);
+
+    start = Clock::now();
+    for (const auto& q : queries) snapshot.find(q);
+    double found = n / seconds_since(start);
+    start = Clock::now();
+    for (const auto& q : queries) snapshot.nearest(q);
+    double nearest = n / seconds_since(start);
+    snapshot.close();
+    std::remove(path);
+
+    printf("snapshot  n=%-9zu write %8.3fs  open %8.5fs  build %8.3fs  find %10.0f  nearest %10.0f queries/s\n",
+      n, write, open, build, found, nearest);
+  }
+
+  // Streaming points in cell order with their counts up front, so cells
+  // finalize as the stream passes, against a batch build holding them all.
+  void bench_stream(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    uint32_t side = std::max<uint32_t>(1, static_cast<uint32_t>(sqrt(n / 64.0)));
+    size_t sent = 0;
+    delaunay::Stream stream(delaunay::Point(-5, -5), delaunay::Point(5, 5), side, side,
+      [&](const uint64_t*, const float*, size_t count) { sent += count; });
+
+    std::vector<uint64_t> counts(stream.cell_count() + 1);
+    std::vector<uint32_t> cells(n);
+    for (size_t i = 0; i < n; ++i) {
+      cells[i] = static_cast<uint32_t>(stream.cell(delaunay::Point(pts[2 * i], pts[2 * i + 1])));
+      ++counts[cells[i]];
+    }
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = static_cast<uint32_t>(i);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return cells[a] < cells[b]; });
+    std::vector<float> sorted(2 * n);
+    for (size_t i = 0; i < n; ++i) {
+      sorted[2 * i] = pts[2 * order[i]];
+      sorted[2 * i + 1] = pts[2 * order[i] + 1];
+    }
+
+    Clock::time_point start = Clock::now();
+    stream.expect(counts.data());
+    size_t offset = 0;
+    stream.run([&](float* xy, size_t capacity) {
+      size_t count = std::min(capacity, n - offset);
+      std::copy(sorted.begin() + 2 * offset, sorted.begin() + 2 * (offset + count), xy);
+      offset += count;
+      return count;
+    }, 4096);
+    double elapsed = seconds_since(start);
+
+    delaunay::Options options;
+    options.m_order = delaunay::Order::brio;
+    options.m_locate = delaunay::Locate::walk;
+    start = Clock::now();
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+    double build = seconds_since(start);
+
+    printf("stream    n=%-9zu %8.3fs  peak %8zu triangles  sent %9zu  batch %8.3fs %9zu triangles %10zu bytes\n",
+      n, elapsed, stream.peak_triangles(), sent, build, tria->triangle_count(), tria->bytes());
+    delete tria;
+  }
+
+  // validate over a whole triangulation, four triangles per test.
+  void bench_validate(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Options options;
+    options.m_engine = delaunay::Engine::divide;
+    delaunay::Triangulation* tria = delaunay::triangulate(pts, options);
+
+    Clock::time_point start = Clock::now();
+    size_t failed = tria->validate();
+    double elapsed = seconds_since(start);
+    printf("validate  n=%-9zu %8.3fs %10.0f triangles/s  failed=%zu\n", n, elapsed,
+      tria->triangle_count() / elapsed, failed);
+    delete tria;
+  }
+
+  // Nearest and 8 nearest vertices of n random points, one at a time and
+  // batched across threads.
+  void bench_nearest(size_t n) {
+    std::vector<float> pts = uniform_points(n, 1);
+    delaunay::Triangulation* tria = delaunay::triangulate(pts);
+
+    std::vector<float> xy = uniform_points(n, 2);
+    std::vector<delaunay::Point> queries(n);
+    for (size_t i = 0; i < n; ++i) queries[i] = delaunay::Point(xy[2 * i], xy[2 * i + 1]);
+
+    Clock::time_point start = Clock::now();
+    for (const auto& q : queries) tria->nearest(q);
+    double single = seconds_since(start);
+
+    std::vector<uint32_t> ids(8 * n);
+    start = Clock::now();
+    tria->nearest(queries.data(), n, ids.data(), 0);
+    double batched = seconds_since(start);
+
+    start = Clock::now();
+    tria->k_nearest(queries.data(), n, 8, ids.data(), 0);
+    double k8 = seconds_since(start);
+    printf("nearest   n=%-9zu single %8.3fs  batched %8.3fs  k=8 %8.3fs\n", n, single,
+      batched, k8);
+    delete tria;
+  }
+}
+
+int main(int argc, char** argv) {
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; ++i) sizes.push_back(strtoul(argv[i], nullptr, 10));
+  if (sizes.empty()) sizes = { 100000, 1000000 };
+
+  std::vector<delaunay::Options> builds(6);
+  builds[1].m_order = builds[2].m_order = builds[3].m_order = delaunay::Order::brio;
+  builds[2].m_locate = builds[3].m_locate = delaunay::Locate::walk;
+  builds[3].m_curve = delaunay::Curve::morton;
+  builds[4].m_engine = delaunay::Engine::divide;
+  builds[5].m_order = delaunay::Order::brio;
+  builds[5].m_kernel = delaunay::Kernel::cavity;
+  for (const auto& options : builds) {
+    for (auto n : sizes) bench_build(n, options);
+  }
+
+  for (auto n : sizes) bench_traits(n);
+  for (auto n : sizes) bench_ingest(n);
+  for (auto n : sizes) bench_export(n);
+
+  for (auto locate : { delaunay::Locate::history, delaunay::Locate::walk }) {
+    for (auto n : sizes) bench_find(n, locate);
+  }
+
+  for (auto locate : { delaunay::Locate::history, delaunay::Locate::walk }) {
+    for (auto n : sizes) bench_find_batch(n, locate);
+  }
+
+  for (auto locate : { delaunay::Locate::history, delaunay::Locate::walk }) {
+    for (auto n : sizes) bench_insert(n, locate);
+  }
+
+  for (auto n : sizes) bench_move(n);
+  for (auto n : sizes) bench_constrain(n);
+  for (auto n : sizes) bench_voronoi(n);
+  for (auto n : sizes) bench_nearest(n);
+  for (auto n : sizes) bench_weld(n);
+  for (auto n : sizes) bench_compact(n);
+  for (auto n : sizes) bench_snapshot(n);
+  for (auto n : sizes) bench_stream(n);
+  for (auto n : sizes) bench_validate(n);
+  return 0;
+}
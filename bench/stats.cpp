@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "delaunay.h"
+#include "predicates.h"
+
+// Counting slows every test down, so the predicate counts get a build of
+// their own instead of skewing the timings in bench.cpp.
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  double seconds_since(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  // Uniform points in a square, the same ones bench.cpp builds from.
+  std::vector<float> uniform_points(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> coord(-5.0f, 5.0f);
+    std::vector<float> pts(2 * n);
+    for (auto& p : pts) p = coord(rng);
+    return pts;
+  }
+
+  // A jittered-free square lattice, full of collinear and cocircular points.
+  std::vector<float> grid_points(size_t n) {
+    size_t side = static_cast<size_t>(sqrt(static_cast<double>(n)));
+    float step = 10.0f / side;
+    std::vector<float> pts;
+    for (size_t i = 0; i < side; ++i) {
+      for (size_t j = 0; j < side; ++j) {
+        pts.push_back(-5.0f + step * j);
+        pts.push_back(-5.0f + step * i);
+      }
+    }
+    return pts;
+  }
+
+  // Share of orientation and incircle tests decided by the double filter.
+  void bench_predicates(size_t n) {
+    for (int grid = 0; grid < 2; ++grid) {
+      std::vector<float> pts = grid ? grid_points(n) : uniform_points(n, 1);
+      delaunay::reset_predicate_stats();
+
+      Clock::time_point start = Clock::now();
+      delaunay::Triangulation* tria = delaunay::triangulate(pts);
+      double build = seconds_since(start);
+      delaunay::PredicateStats stats = delaunay::predicate_stats();
+
+      printf("filter    %-8s n=%-9zu %8.3fs  orient %5.2f%% of %llu  incircle %5.2f%% of %llu\n",
+        grid ? "grid" : "uniform", pts.size() / 2, build,
+        100.0 - 100.0 * stats.m_orient_exact / stats.m_orient,
+        static_cast<unsigned long long>(stats.m_orient),
+        100.0 - 100.0 * stats.m_incircle_exact / stats.m_incircle,
+        static_cast<unsigned long long>(stats.m_incircle));
+      delete tria;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; ++i) sizes.push_back(strtoul(argv[i], nullptr, 10));
+  if (sizes.empty()) sizes = { 100000, 1000000 };
+
+  for (auto n : sizes) bench_predicates(n);
+  return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace delaunay {
+  // Chunked bump allocator. Objects are carved out of fixed size chunks and
+  // chunks are only released all at once. Destroyed objects go on a free
+  // list that later creates draw from first.
+  template <typename T, size_t ChunkSize = 4096>
+  class Arena {
+    static_assert(std::is_trivially_destructible<T>::value,
+      "Arena never runs destructors.");
+    static_assert(sizeof(T) >= sizeof(void*),
+      "The free list is threaded through destroyed objects.");
+
+  public:
+    Arena() : m_head(nullptr), m_end(nullptr), m_free(nullptr), m_count(0) {};
+
+    ~Arena() {
+      clear();
+    };
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+      ++m_count;
+      if (m_free) {
+        T* t = m_free;
+        m_free = *reinterpret_cast<T**>(t);
+        return new (t) T(std::forward<Args>(args)...);
+      }
+      if (m_head == m_end) grow();
+      return new (m_head++) T(std::forward<Args>(args)...);
+    };
+
+    // Hands t's slot back for reuse. Overwrites its first pointer's worth
+    // of bytes, the rest is left as it was.
+    void destroy(T* t) {
+      --m_count;
+      *reinterpret_cast<T**>(t) = m_free;
+      m_free = t;
+    };
+
+    // Releases every chunk. All pointers handed out become invalid.
+    void clear() {
+      for (auto chunk : m_chunks) {
+        ::operator delete(chunk);
+      }
+      m_chunks.clear();
+      m_head = m_end = m_free = nullptr;
+      m_count = 0;
+    };
+
+    // Number of live objects.
+    size_t size() const {
+      return m_count;
+    };
+
+    // Calls fn on every slot handed out since the last clear, oldest first.
+    // Destroyed objects are visited too, callers have to recognize them.
+    template <typename Fn>
+    void for_each(Fn fn) {
+      for (size_t i = 0; i < m_chunks.size(); ++i) {
+        T* begin = first(m_chunks[i]);
+        T* end = i + 1 < m_chunks.size() ? begin + ChunkSize : m_head;
+        for (T* t = begin; t != end; ++t) fn(t);
+      }
+    };
+
+    // Bytes reserved from the system.
+    size_t bytes() const {
+      return m_chunks.size() * ChunkSize * sizeof(T);
+    };
+
+  private:
+    // First object slot of chunk, aligned for T.
+    static T* first(void* chunk) {
+      uintptr_t p = reinterpret_cast<uintptr_t>(chunk);
+      p = (p + alignof(T) - 1) & ~static_cast<uintptr_t>(alignof(T) - 1);
+      return reinterpret_cast<T*>(p);
+    };
+
+    void grow() {
+      // Over-allocate so types aligned beyond what new guarantees still get
+      // aligned objects.
+      size_t slack = alignof(T) > alignof(std::max_align_t) ? alignof(T) : 0;
+      void* chunk = ::operator new(ChunkSize * sizeof(T) + slack);
+      m_chunks.push_back(chunk);
+      m_head = first(chunk);
+      m_end = m_head + ChunkSize;
+    };
+
+    std::vector<void*> m_chunks;
+    T* m_head;
+    T* m_end;
+    T* m_free;
+    size_t m_count;
+  };
+}
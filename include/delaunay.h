@@ -1,24 +1,98 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 #include <vector>
 #include <set>
+#include <unordered_set>
+
+#include "arena.h"
+#include "predicates.h"
 
 namespace delaunay {
-  struct Point {
-    Point() : x(0), y(0) {};
-    Point(float x, float y) : x(x), y(y) {};
-    float x;
-    float y;
+  template <typename T>
+  struct BasicPoint {
+    BasicPoint() : x(0), y(0) {};
+    BasicPoint(T x, T y) : x(x), y(y) {};
+
+    bool operator==(const BasicPoint& p) const {
+      return x == p.x && y == p.y;
+    };
+
+    bool operator!=(const BasicPoint& p) const {
+      return !(*this == p);
+    };
+
+    T x;
+    T y;
+  };
+
+  typedef BasicPoint<float> Point;
+  typedef BasicPoint<double> DoublePoint;
+  typedef BasicPoint<int32_t> IntPoint;
+
+  // The i-th point of a buffer of x, y pairs that start stride bytes apart,
+  // so interleaved layouts like x, y, z can be read in place.
+  template <typename T>
+  inline BasicPoint<T> point_at(const T* xy, size_t stride, size_t i) {
+    const T* p = reinterpret_cast<const T*>(
+      reinterpret_cast<const char*>(xy) + i * stride);
+    return BasicPoint<T>(p[0], p[1]);
+  }
+
+  // Id of the symbolic vertex at infinity. Every edge of the convex hull
+  // has a ghost triangle on its outer side with this as the third vertex,
+  // so the plane is covered without a bounding triangle.
+  const uint32_t infinite_vertex = 0xffffffffu;
+
+  // Returned by insert when the point was not added.
+  const uint32_t no_vertex = 0xfffffffeu;
+
+  // Returned by find_batch for points outside the hull.
+  const uint32_t no_triangle = 0xffffffffu;
+
+  // Placement of a grid of square cells over a set of vertices, row after
+  // row, each cell holding the id of a vertex in it or no_vertex so a walk
+  // can start next to its target. Cell x, y covers the points whose
+  // (p - min) * m_scale rounds down to x, y. Plain data, snapshots store it
+  // as is.
+  struct GridShape {
+    uint32_t m_columns;
+    uint32_t m_rows;
+    double m_min_x;
+    double m_min_y;
+    double m_scale;
+
+    GridShape() : m_columns(0), m_rows(0), m_min_x(0), m_min_y(0), m_scale(0) {};
+
+    // Index of the cell nearest to x, y. NaN coordinates get cell 0.
+    size_t cell(double x, double y) const {
+      double cx = (x - m_min_x) * m_scale;
+      double cy = (y - m_min_y) * m_scale;
+      cx = cx > 0 ? std::min(cx, m_columns - 1.0) : 0;
+      cy = cy > 0 ? std::min(cy, m_rows - 1.0) : 0;
+      return static_cast<size_t>(cy) * m_columns + static_cast<size_t>(cx);
+    };
   };
 
-  struct TriNode {
+  template <typename T>
+  struct BasicTriNode {
     // Vertices of the triangle.
-    Point m_pts[3];
-    TriNode* m_children[3];
+    BasicPoint<T> m_pts[3];
+    BasicTriNode* m_children[3];
+    // Leaf triangle across the edge m_pts[i], m_pts[(i + 1) % 3]. Only kept
+    // up to date while the node is a leaf.
+    BasicTriNode* m_neighbors[3];
+    // Vertex ids of m_pts, indices into the triangulation's vertex table.
+    uint32_t m_ids[3];
+    // Index in the triangulation's leaf list while the node is a leaf.
+    uint32_t m_slot;
 
-    TriNode(const Point& p1,
-      const Point& p2,
-      const Point& p3) {
+    BasicTriNode(const BasicPoint<T>& p1,
+      const BasicPoint<T>& p2,
+      const BasicPoint<T>& p3) {
       m_pts[0] = p1;
       m_pts[1] = p2;
       m_pts[2] = p3;
@@ -26,57 +100,613 @@ namespace delaunay {
       m_children[0] = nullptr;
       m_children[1] = nullptr;
       m_children[2] = nullptr;
+
+      m_neighbors[0] = nullptr;
+      m_neighbors[1] = nullptr;
+      m_neighbors[2] = nullptr;
+
+      m_ids[0] = 0;
+      m_ids[1] = 0;
+      m_ids[2] = 0;
+
+      m_slot = 0;
+    };
+
+    // Whether this is a ghost, one of the triangles outside the hull. Ghosts
+    // are never leaves of the output.
+    bool is_ghost() const {
+      return m_ids[0] == infinite_vertex
+        || m_ids[1] == infinite_vertex
+        || m_ids[2] == infinite_vertex;
     };
   };
 
-  class Triangulation {
+  typedef BasicTriNode<float> TriNode;
+
+  // How the leaf triangles containing a point are located.
+  enum class Locate {
+    // Descend the history DAG from its roots. Points outside the hull
+    // fall back to walking.
+    history,
+    // Remembering stochastic walk over the leaves, starting from the last
+    // located triangle. Fast when consecutive queries are close together.
+    walk,
+  };
+
+  // Order triangulate inserts the points in.
+  enum class Order {
+    // Uniform random shuffle.
+    shuffle,
+    // Biased randomized insertion order, see brio in order.h. Pairs well
+    // with Locate::walk since each point lands next to the previous one.
+    brio,
+  };
+
+  // Space filling curve used to sort each round of Order::brio.
+  enum class Curve {
+    hilbert,
+    morton,
+  };
+
+  // How insert restores the Delaunay property around a new point.
+  enum class Kernel {
+    // Split the containing triangle and flip illegal edges one by one.
+    flip,
+    // Bowyer-Watson, remove every triangle whose circumcircle holds the
+    // point and fan the hole from it. Freed triangles are reused, which
+    // needs dropping the history.
+    cavity,
+  };
+
+  // How triangulate builds the triangulation.
+  enum class Engine {
+    // Randomized incremental insertion with a history DAG.
+    incremental,
+    // Divide and conquer over x sorted slabs, see divide.h. Leaves no
+    // history, so the result always locates by walking.
+    divide,
+  };
+
+  struct Options {
+    Options() : m_engine(Engine::incremental),
+      m_kernel(Kernel::flip),
+      m_locate(Locate::history),
+      m_order(Order::shuffle),
+      m_curve(Curve::hilbert),
+      m_weld(false),
+      m_threads(0) {};
+
+    Engine m_engine;
+    Kernel m_kernel;
+    Locate m_locate;
+    Order m_order;
+    Curve m_curve;
+    // Merge duplicates with weld, see weld.h, before anything is located,
+    // so the build skips looking for them.
+    bool m_weld;
+    // Threads used for sorting and by Engine::divide, 0 uses every hardware
+    // thread.
+    unsigned m_threads;
+  };
+
+  // Traits a triangulation is compiled for:
+  //   Scalar, the coordinate type of its points.
+  //   Predicates, the orientation and incircle policy, see predicates.h.
+  //   Allocator<Node>, owner of the triangles, with Arena's create,
+  //   destroy, clear and bytes.
+  //   tolerance(), the distance along either axis below which two points
+  //   count as one.
+  // All of them are resolved at compile time. The traits below are built
+  // into the library, others need their instantiations added at the end of
+  // delaunay.cpp, divide.cpp and voronoi.cpp.
+  struct FloatTraits {
+    typedef float Scalar;
+    typedef ExactPredicates Predicates;
+    template <typename Node>
+    using Allocator = Arena<Node>;
+
+    static Scalar tolerance() {
+      return 0.001f;
+    }
+  };
+
+  // For large coordinates like UTM, where float steps are half a meter.
+  struct DoubleTraits {
+    typedef double Scalar;
+    typedef ExactPredicates Predicates;
+    template <typename Node>
+    using Allocator = Arena<Node>;
+
+    static Scalar tolerance() {
+      return 0.001;
+    }
+  };
+
+  // Compact and quick, for previews of points known to be well spread.
+  struct FastFloatTraits : FloatTraits {
+    typedef FastPredicates Predicates;
+  };
+
+  // Points already on a grid, like survey data in millimeters, from
+  // -2^31 + 1 to 2^31 - 1 steps, INT32_MIN stands in for the vertex at
+  // infinity. The predicates run in exact integer arithmetic and only
+  // identical points count as one, so the result is the same on every
+  // machine.
+  struct IntTraits {
+    typedef int32_t Scalar;
+    typedef ExactPredicates Predicates;
+    template <typename Node>
+    using Allocator = Arena<Node>;
+
+    static Scalar tolerance() {
+      return 1;
+    }
+  };
+
+  template <typename T>
+  struct BasicVoronoi;
+
+  template <typename Traits>
+  class BasicTriangulation;
+
+  template <typename Traits>
+  bool write_snapshot(const BasicTriangulation<Traits>& tria, const char* path);
+
+  template <typename Traits>
+  class BasicTriangulation {
   public:
-    Triangulation(const Point& p1,
-      const Point& p2,
-      const Point p3,
-      const std::vector<Point>& ps);
+    typedef typename Traits::Scalar Scalar;
+    typedef BasicPoint<Scalar> Point;
+    typedef BasicTriNode<Scalar> TriNode;
+
+    // Empty, points may go anywhere. Nothing is triangulated until three of
+    // them are not on one line.
+    BasicTriangulation();
+
+    // Adds pt and restores the Delaunay property around it. Points outside
+    // the hull grow it. Returns the vertex id of pt, or no_vertex if pt is
+    // too close to an existing vertex.
+    uint32_t insert(const Point& pt);
+
+    // Takes vertex id out, retriangulates the hole around it and flips
+    // until the triangles there are Delaunay again. Nothing outside the
+    // hole changes. The id is not reused and keeps its entry in
+    // get_vertices. Constraints ending at id go with it. Returns false if id
+    // is not a vertex. Drops the history for good.
+    bool remove(uint32_t id);
+
+    // Removes the vertex within the duplicate tolerance of pt.
+    bool remove(const Point& pt);
+
+    // Moves vertex id to pos, keeping its id. While pos stays inside the
+    // star of id the triangles just follow and a few flips restore the
+    // Delaunay property, otherwise id is removed and inserted again, losing
+    // the constraints ending at it. Returns false, changing nothing, if it
+    // is not a vertex or pos is too close to another one. Drops the history
+    // for good once it moves.
+    bool move_vertex(uint32_t id, const Point& pos);
+
+    // Moves each of the count vertices ids[i] to positions[i], as one frame
+    // of a moving point set. Vertices that leave their star are all taken
+    // out first and put back in along a space filling curve. A move is
+    // refused, leaving the vertex as it was, if its position is within the
+    // duplicate tolerance of a vertex that is in place when its turn comes
+    // or of an earlier position in the frame. One whose spot is taken by
+    // the time it is put back goes back where it was. If that is taken too
+    // it ends up removed, as by remove, and unless null lost gets its id.
+    // Returns how many ended up at their new position.
+    size_t move_vertices(const uint32_t* ids,
+      const Point* positions,
+      size_t count,
+      std::vector<uint32_t>* lost = nullptr);
+
+    // Forces the segment between vertices a and b into the triangulation as
+    // a constraint no flip may remove. Vertices on the segment split it,
+    // and a constraint it crosses splits both at a new vertex where they
+    // meet. Only the triangles the segment crosses change. Returns false if
+    // a or b is not in a triangle.
+    bool insert_segment(uint32_t a, uint32_t b);
+
+    // Inserts the endpoints first, or takes the vertices already within the
+    // duplicate tolerance of them.
+    bool insert_segment(const Point& a, const Point& b);
+
+    // Inserts count segments, the i-th between vertices ends[2 * i] and
+    // ends[2 * i + 1]. Each starts from the triangles around its first
+    // vertex, so the cost follows the triangles crossed rather than the
+    // size of the triangulation. Returns how many went in.
+    size_t insert_segments(const uint32_t* ends, size_t count);
+
+    // Whether the edge between vertices a and b is a constraint.
+    bool is_constrained(uint32_t a, uint32_t b) const;
+
+    // Flips the edge shared by node and its neighbor across edge. The two
+    // new triangles become the children of both old ones and are returned
+    // through t1 and t2, each starting with the vertex of node opposite edge.
+    void flip(TriNode* node, int edge, TriNode*& t1, TriNode*& t2);
+
+    // Flips edge of node if it isn't a constraint and the neighbor's far
+    // vertex lies in the node's circumcircle, and recurses on the edges
+    // that become exposed. Expects the vertex opposite edge to be the most
+    // recently inserted point.
+    void legalize(TriNode* node, int edge);
+
+    // Vertices of every leaf triangle inside the hull as x, y pairs, three per triangle.
+    std::vector<Scalar> get_tris() const;
+
+    // Writes the same coordinates to tris, which must have room for
+    // 6 * triangle_count() of them. Returns how many were written.
+    size_t get_tris(Scalar* tris) const;
 
-    ~Triangulation();
+    size_t triangle_count() const;
 
-    TriNode* insert(const Point& pt);
+    // Every vertex, indexed by vertex id. Ids are handed out in insertion
+    // order, removed vertices stay but no triangle uses them.
+    const std::vector<Point>& get_vertices() const;
 
-    TriNode* split(const Point& p1, const Point& p2);
+    // Vertex ids of every leaf triangle, three per triangle and counter
+    // clockwise, in the same order as get_tris.
+    std::vector<uint32_t> get_indices() const;
 
-    std::vector<float> get_tris();
+    // Writes the same ids to indices, which must have room for
+    // 3 * triangle_count() of them. Returns how many were written.
+    size_t get_indices(uint32_t* indices) const;
+
+    // Bytes held by the triangles, history included, the vertex list, the
+    // constraints and the grid compact sets up.
+    size_t bytes() const;
 
     // Finds the leaf nodes of the tree the point is contained in.
     // A point could be contained in many nodes if it is already an existing vertex.
+    // When walking only the single leaf the walk stops in is returned.
+    // Points outside the hull are in none.
     void find(const Point& pt, std::vector<TriNode*>& nodes);
 
-    void get_triangulation(TriNode*& node,
-      std::vector<float>& tris,
-      std::set<TriNode*>& visited);
+    // Locates each of the count points in xy, packed x, y pairs, and writes
+    // the index of the leaf triangle containing it in the order of
+    // get_indices to triangles, or no_triangle outside the hull. The points
+    // are sorted along a space filling curve and split across up to threads
+    // threads, 0 using every hardware thread, each walking from where its
+    // last point was found. Nothing is allocated per point.
+    void find_batch(const Scalar* xy, size_t count, uint32_t* triangles, unsigned threads = 0) const;
+
+    // Checks every leaf is counter clockwise and linked both ways with its
+    // neighbors, and that no edge but a constraint has the far vertex of
+    // the triangle across it inside its circumcircle. The triangles are
+    // tested four at a time. Returns how many checks failed, 0 if all is
+    // well.
+    size_t validate() const;
+
+    // The vertex closest to pt, or no_vertex if there are none. Walks to the
+    // triangle around pt like find and then along the edges to ever closer
+    // vertices, which always ends at the closest one. Constraints keep some
+    // Delaunay edges out, so with any in it may stop at a vertex merely close.
+    uint32_t nearest(const Point& pt);
+
+    // The k vertices closest to pt, closest first, into ids. Fewer if there
+    // aren't k. Grows outwards from the closest one along the edges, since
+    // the k closest to any point are always connected by them.
+    void k_nearest(const Point& pt, size_t k, std::vector<uint32_t>& ids);
+
+    // nearest of each of the count points in pts into ids, on up to threads
+    // threads, 0 using every hardware thread. The points are sorted along a
+    // space filling curve first so each walk starts next to the last one.
+    void nearest(const Point* pts, size_t count, uint32_t* ids, unsigned threads) const;
+
+    // k_nearest of each of the count points in pts, k ids per point into
+    // ids, padded with no_vertex where there aren't k.
+    void k_nearest(const Point* pts, size_t count, size_t k, uint32_t* ids, unsigned threads) const;
+
+    // Makes room for count more points up front.
+    void reserve(size_t count);
+
+    // Triangulations without history ignore Locate::history.
+    void set_locate(Locate locate);
+    Locate get_locate() const;
+
+    // Switching to Kernel::cavity drops the history for good.
+    void set_kernel(Kernel kernel);
+    Kernel get_kernel() const;
+
+    // For a triangulation that is done changing. Drops the history and
+    // copies the leaves and ghosts into fresh storage, ordered along a
+    // Hilbert curve through their centroids so neighbors sit close in
+    // memory, releasing everything else. Locating walks from then on,
+    // starting at a vertex picked from a coarse grid over the points
+    // instead of wherever the last walk ended. Unless null, ids gets the
+    // new id of every vertex: live ones are renumbered along the same curve
+    // and removed ones are dropped and get no_vertex. Without ids vertex
+    // ids stay as they are. Later edits still work, but new triangles go
+    // wherever the allocator puts them. The sorts run on up to threads
+    // threads, 0 using every hardware thread.
+    void compact(std::vector<uint32_t>* ids = nullptr, unsigned threads = 1);
 
   private:
-    // Finds the leaf nodes of the tree the point is contained in.
+    template <typename T>
+    friend BasicTriangulation<T>* divide_and_conquer(const typename T::Scalar* xy,
+      size_t count,
+      size_t stride,
+      unsigned threads,
+      std::vector<uint32_t>* ids);
+    template <typename T>
+    friend BasicTriangulation<T>* triangulate(const typename T::Scalar* xy,
+      size_t count,
+      size_t stride,
+      const Options& options,
+      std::vector<uint32_t>* ids);
+    template <typename T>
+    friend void voronoi(const BasicTriangulation<T>& tria,
+      const BasicPoint<typename T::Scalar>& min,
+      const BasicPoint<typename T::Scalar>& max,
+      unsigned threads,
+      BasicVoronoi<typename T::Scalar>& out);
+    template <typename T>
+    friend bool write_snapshot(const BasicTriangulation<T>& tria, const char* path);
+
+    // The geometric tests, bound to the traits' predicates and tolerance.
+    static double orient(const Point& a, const Point& b, const Point& c) {
+      return Traits::Predicates::orient(a, b, c);
+    }
+
+    static double incircle(const Point& a, const Point& b, const Point& c, const Point& d) {
+      return Traits::Predicates::incircle(a, b, c, d);
+    }
+
+    // Whether p1 and p2 are within the duplicate tolerance.
+    static bool equal(const Point& p1, const Point& p2);
+
+    static bool vert_in(const Point& p, const Point* pts);
+
+    // Inclusive of the boundary, pts must be counter clockwise.
+    static bool point_in_tri(const Point& pt, const Point* pts);
+
+    // Strictly inside, a, b, c must be counter clockwise.
+    static bool point_in_circle(const Point& pt, const Point& a, const Point& b, const Point& c);
+
+    // Whether pt is strictly inside the circumcircle of node. For a ghost
+    // a, b, infinity that is the open half plane left of a-b, plus the open
+    // segment a-b, which is what the circle tends to as its third point leaves.
+    static bool conflicts(const TriNode* node, const Point& pt);
+
+    // Creates a triangle from three vertex ids. Adds it to the leaves unless
+    // it is a ghost.
+    TriNode* make_leaf(uint32_t a, uint32_t b, uint32_t c);
+
+    // Takes node off the leaves once it was split, flipped or deleted.
+    void remove_leaf(TriNode* node);
+
+    // Adds pt to the vertex table and returns its id.
+    uint32_t add_vertex(const Point& pt);
+
+    // The vertex within the duplicate tolerance of pt, or no_vertex.
+    uint32_t vertex_near(const Point& pt);
+
+    // Puts vertex id, which is in no triangle, into the triangulation at
+    // m_points[id]. While every point so far is on one line it is held on
+    // to instead. Returns false if a vertex that close is already in.
+    bool place(uint32_t id);
+
+    // Triangulates the pending points once they are not all on one line.
+    void flush_pending();
+
+    // Stops keeping the history, with m_last left on a leaf.
+    void drop_history();
+
+    // The first triangle a, b, c and a ghost on each of its edges.
+    void start(uint32_t a, uint32_t b, uint32_t c);
+
+    // Adds vertex id, which lies in node, and restores the Delaunay property
+    // around it.
+    void link(TriNode* node, uint32_t id);
+
+    // A leaf containing pt, or the ghost beyond the hull edge pt is outside
+    // of. nullptr if pt is an existing vertex.
+    TriNode* locate(const Point& pt);
+
+    // Splits node and its neighbor across edge at vertex id, which lies on
+    // that edge. The new triangles go in c, each starting with id. Returns
+    // how many there are.
+    int split_edge(TriNode* node, int edge, uint32_t id, TriNode** c);
+
+    // Bowyer-Watson insertion of vertex id, which lies in node. Returns one
+    // of the new triangles that isn't a ghost, they all start with id.
+    TriNode* insert_cavity(TriNode* node, uint32_t id);
+
+    // Goes around vertex id counter clockwise, putting each triangle of its
+    // star in m_cavity, the link vertex after id in m_link and the triangle
+    // across the link edge in m_outer. Returns how many aren't ghosts.
+    size_t star(uint32_t id);
+
+    // Moves vertex id to pos if that keeps every triangle of its star
+    // counter clockwise and the hull convex, then flips the star back to
+    // Delaunay. Returns false without changing anything otherwise.
+    bool shift(uint32_t id, const Point& pos);
+
+    // Points the next walk at a triangle around vertex id.
+    void walk_from(uint32_t id);
+
+    // A leaf around vertex id, the neighbor of a ghost one inside the hull.
+    TriNode* solid(uint32_t id) const;
+
+    // Where a walk to pt starts, the leaf around the vertex in pt's cell of
+    // m_grid or m_last when there is none.
+    TriNode* start_near(const Point& pt) const;
+
+    // Lays a grid of about two vertices to a cell over the vertices in a
+    // triangle and fills cells with one of each. Empty for fewer than 64.
+    void build_grid(GridShape& shape, std::vector<uint32_t>& cells) const;
+
+    // The triangle with the edge from u to v, and the index of that edge
+    // in it. nullptr if there is no such edge.
+    TriNode* find_edge(uint32_t u, uint32_t v, int& edge) const;
+
+    // Flips the edges crossing the segment from a to b out of the way and
+    // marks the pieces between the vertices on it as constraints.
+    bool constrain(uint32_t a, uint32_t b);
+
+    // Triangulates the polygon m_link, which has m_outer across each edge,
+    // into m_fan. A link through the vertex at infinity is scanned into
+    // triangles and ghosts, ears are clipped otherwise.
+    void fill_hole();
+
+    // Flips every illegal edge reachable from those in m_edges. Replaced
+    // triangles are freed at the end.
+    void restore();
+
+    // Where one thread's nearest neighbor queries are, and scratch space
+    // for them.
+    struct Search {
+      TriNode* m_start;
+      uint32_t m_seed;
+      std::vector<uint32_t> m_around;
+      std::vector<std::pair<double, uint32_t>> m_heap;
+      std::unordered_set<uint32_t> m_seen;
+    };
+
+    // Starts search at the leaf find locates pt in, or where the last walk
+    // ended if pt is outside the hull.
+    void start_search(const Point& pt, Search& search);
+
+    // Puts the vertices sharing an edge with vertex id in out, counter
+    // clockwise, the vertex at infinity included on the hull.
+    void adjacent(uint32_t id, std::vector<uint32_t>& out) const;
+
+    // The vertex closest to pt, walking from and then moving search.m_start.
+    uint32_t closest(const Point& pt, Search& search) const;
+
+    // Writes the k vertices closest to pt to ids, padded with no_vertex.
+    // Returns how many there are.
+    size_t k_closest(const Point& pt, size_t k, Search& search, uint32_t* ids) const;
+
+    // Walks from start towards pt over the leaves. Returns the leaf
+    // containing pt, or the first ghost reached if pt is outside the hull.
+    TriNode* walk(const Point& pt, TriNode* start, uint32_t& seed) const;
+
+    // Finds the leaf nodes of the tree the point is contained in, below
+    // those of the count candidates that contain it, testing four
+    // candidates at a time.
     // A point could be contained in many nodes if it is already an existing vertex.
-    void find(const Point& pt, 
-      TriNode* node, 
-      std::vector<TriNode*>& nodes, 
+    void find(const Point& pt,
+      TriNode* const* candidates,
+      size_t count,
+      std::vector<TriNode*>& nodes,
       std::set<TriNode*>& added);
 
-    // Find all triangles containing both p1 and p2.
-    void find_by_edge(const Point& p1,
-      const Point& p2,
-      TriNode* node,
-      std::vector<TriNode*>& nodes);
+    // Owns every node of the history DAG, released in one go on destruction.
+    typename Traits::template Allocator<TriNode> m_nodes;
+    // Whether split and flipped nodes keep pointing at their children.
+    bool m_history;
+    // The first triangle, and every triangle made outside the hull of the
+    // points before it. Together they cover the hull.
+    std::vector<TriNode*> m_roots;
+    // Every leaf except the ghosts, unordered. Removal swaps the last one
+    // into the hole.
+    std::vector<TriNode*> m_leaves;
+    // Vertex table, indexed by vertex id.
+    std::vector<Point> m_points;
+    // Constrained edges, keyed by their two vertex ids, the smaller one in
+    // the upper half.
+    std::unordered_set<uint64_t> m_fixed;
+    // A leaf around each vertex, the last one made. Null for removed and
+    // pending vertices.
+    std::vector<TriNode*> m_incident;
+    // Vertices waiting for a triangle, all on one line.
+    std::vector<uint32_t> m_pending;
 
-    void recursive_delete(TriNode*& node);
+    Locate m_locate;
+    Kernel m_kernel;
+    // Where the next walk starts, may have been replaced since.
+    TriNode* m_last;
+    // Set up by compact, a vertex per cell of m_grid_shape. Removed
+    // vertices are skipped when looked up.
+    GridShape m_grid_shape;
+    std::vector<uint32_t> m_grid;
+    uint32_t m_seed;
+    // Set while triangulate inserts welded points, none of which can be a
+    // duplicate, so locate doesn't look for one.
+    bool m_welded;
 
-    TriNode* m_root;
-    std::vector<Point> m_points;
+    // Scratch space for insert_cavity, remove and shift, kept to avoid
+    // allocating per point.
+    std::vector<TriNode*> m_cavity;
+    std::vector<TriNode*> m_fan;
+    std::vector<uint32_t> m_link;
+    std::vector<TriNode*> m_outer;
+    std::vector<std::pair<TriNode*, int>> m_edges;
+    // Edges crossing the segment being constrained, and those flipping
+    // them made that don't, as vertex id pairs.
+    std::vector<std::pair<uint32_t, uint32_t>> m_crossed;
+    std::vector<std::pair<uint32_t, uint32_t>> m_flipped;
   };
 
-  void circle(const Point& a, 
-    const Point& b, 
-    const Point& c, 
-    Point& center, 
-    float& radius);
+  typedef BasicTriangulation<FloatTraits> Triangulation;
+  typedef BasicTriangulation<DoubleTraits> DoubleTriangulation;
+  typedef BasicTriangulation<IntTraits> IntTriangulation;
+
+  template <typename T>
+  void circle(const BasicPoint<T>& a,
+    const BasicPoint<T>& b,
+    const BasicPoint<T>& c,
+    BasicPoint<T>& center,
+    T& radius);
+
+  // Center of the circle through a, b and c, a itself if they are on one
+  // line.
+  template <typename T>
+  BasicPoint<T> circumcenter(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c);
+
+  // Builds the triangulation of count points read in place from xy, each
+  // stride bytes after the previous one, for any of the built in traits.
+  template <typename Traits>
+  BasicTriangulation<Traits>* triangulate(const typename Traits::Scalar* xy,
+    size_t count,
+    size_t stride,
+    const Options& options = Options());
+
+  // Same, and unless null fills ids with the vertex id of each point, that
+  // of the vertex it merged into for a duplicate, so attributes stored per
+  // point can be carried over to the vertices.
+  template <typename Traits>
+  BasicTriangulation<Traits>* triangulate(const typename Traits::Scalar* xy,
+    size_t count,
+    size_t stride,
+    const Options& options,
+    std::vector<uint32_t>* ids);
+
+  Triangulation* triangulate(const float* xy,
+    size_t count,
+    size_t stride,
+    const Options& options = Options());
+
+  DoubleTriangulation* triangulate(const double* xy,
+    size_t count,
+    size_t stride,
+    const Options& options = Options());
+
+  IntTriangulation* triangulate(const int32_t* xy,
+    size_t count,
+    size_t stride,
+    const Options& options = Options());
+
+  // Packed x, y pairs.
+  Triangulation* triangulate(const std::vector<float>& points,
+    const Options& options = Options());
+
+  DoubleTriangulation* triangulate(const std::vector<double>& points,
+    const Options& options = Options());
+
+  IntTriangulation* triangulate(const std::vector<int32_t>& points,
+    const Options& options = Options());
+
+  Triangulation* triangulate(const std::vector<float>& points,
+    const Options& options,
+    std::vector<uint32_t>* ids);
+
+  DoubleTriangulation* triangulate(const std::vector<double>& points,
+    const Options& options,
+    std::vector<uint32_t>* ids);
 
-  Triangulation* triangulate(const std::vector<float>& points);
+  IntTriangulation* triangulate(const std::vector<int32_t>& points,
+    const Options& options,
+    std::vector<uint32_t>* ids);
 }
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+#include "delaunay.h"
+
+// Divide and conquer construction after Guibas and Stolfi, "Primitives for
+// the Manipulation of General Subdivisions and the Computation of Voronoi
+// Diagrams".
+
+namespace delaunay {
+  // Triangulates the count points in xy, spaced stride bytes apart. The
+  // points are sorted by x and split into slabs, the slabs are triangulated
+  // on up to threads threads and merged back pairwise. Gives the same leaf
+  // triangles as inserting the points one at a time, up to the choice of
+  // diagonal among cocircular points, but keeps every distinct point where
+  // insert drops those within its duplicate tolerance. The result has no
+  // history. Float points are sorted with a radix sort, double ones with
+  // a comparison sort. Unless null, ids gets the vertex id of each point.
+  template <typename Traits>
+  BasicTriangulation<Traits>* divide_and_conquer(const typename Traits::Scalar* xy,
+    size_t count,
+    size_t stride,
+    unsigned threads,
+    std::vector<uint32_t>* ids);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "delaunay.h"
+
+// Spatially coherent insertion orders.
+
+namespace delaunay {
+  // Position of (x, y) along a curve through a 2^bits by 2^bits grid.
+  uint32_t hilbert_key(uint32_t x, uint32_t y, int bits);
+  uint32_t morton_key(uint32_t x, uint32_t y, int bits);
+
+  // Sorts items by their upper 32 bits with a stable least significant
+  // digit radix sort, each pass split across threads.
+  void radix_sort(std::vector<uint64_t>& items, unsigned threads);
+
+  // Fills order with the indices of the count float or double points in
+  // xy, spaced stride bytes apart, in a biased randomized insertion order. Points are
+  // assigned to rounds of doubling size at random and each round is sorted
+  // along curve, so consecutive points are close without losing the
+  // expected complexity of a random order.
+  template <typename T>
+  void brio(const T* xy,
+    size_t count,
+    size_t stride,
+    Curve curve,
+    unsigned threads,
+    std::vector<uint32_t>& order);
+
+  // Fills order with the indices of the points sorted along curve, all in
+  // one round. For queries, which don't need the randomness.
+  template <typename T>
+  void curve_order(const T* xy,
+    size_t count,
+    size_t stride,
+    Curve curve,
+    unsigned threads,
+    std::vector<uint32_t>& order);
+}
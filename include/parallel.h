@@ -0,0 +1,28 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace delaunay {
+  // Resolves a requested thread count, 0 meaning one per hardware thread.
+  inline unsigned thread_count(unsigned threads) {
+    if (threads) return threads;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? hw : 1;
+  }
+
+  // Splits [0, count) into one contiguous range per thread and calls
+  // fn(begin, end, thread) for each. The calling thread runs the last range.
+  template <typename Fn>
+  void parallel_for(size_t count, unsigned threads, Fn fn) {
+    size_t n = std::max<size_t>(1, std::min<size_t>(thread_count(threads), count));
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t + 1 < n; ++t) {
+      workers.emplace_back(fn, count * t / n, count * (t + 1) / n, static_cast<unsigned>(t));
+    }
+    fn(count * (n - 1) / n, count, static_cast<unsigned>(n - 1));
+    for (auto& w : workers) w.join();
+  }
+}
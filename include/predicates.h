@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+
+// Orientation and incircle tests. Each evaluates its determinant in double
+// precision and only falls back to exact expansion arithmetic when the
+// result is within the rounding error bound, so the sign is always right.
+// Defined for float and double coordinates, and for int32 grid coordinates,
+// which compilers with 128 bit integers evaluate exactly in integer
+// arithmetic with no filter at all.
+
+namespace delaunay {
+  template <typename T>
+  struct BasicPoint;
+
+  // Positive if c lies left of the line a->b, negative if right and zero
+  // if the three points are collinear.
+  template <typename T>
+  double orient(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c);
+
+  // Positive if d lies inside the circle through the counter clockwise
+  // triangle a, b, c, negative if outside and zero if on it.
+  template <typename T>
+  double incircle(const BasicPoint<T>& a,
+    const BasicPoint<T>& b,
+    const BasicPoint<T>& c,
+    const BasicPoint<T>& d);
+
+#ifdef __SIZEOF_INT128__
+  template <>
+  double orient(const BasicPoint<int32_t>& a, const BasicPoint<int32_t>& b, const BasicPoint<int32_t>& c);
+
+  // Returns just the sign, -1, 0 or 1.
+  template <>
+  double incircle(const BasicPoint<int32_t>& a,
+    const BasicPoint<int32_t>& b,
+    const BasicPoint<int32_t>& c,
+    const BasicPoint<int32_t>& d);
+#endif
+
+  // Predicate policies a triangulation's traits pick from. The triangulation
+  // calls them directly, so the choice costs nothing at run time.
+
+  // The exact tests above.
+  struct ExactPredicates {
+    template <typename T>
+    static double orient(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c) {
+      return delaunay::orient(a, b, c);
+    }
+
+    template <typename T>
+    static double incircle(const BasicPoint<T>& a,
+        const BasicPoint<T>& b,
+        const BasicPoint<T>& c,
+        const BasicPoint<T>& d) {
+      return delaunay::incircle(a, b, c, d);
+    }
+  };
+
+  // The same determinants in plain double precision, with no filter and no
+  // fallback. Nearly degenerate points can get the wrong sign, which can
+  // leave triangles that aren't Delaunay or send a walk in circles, so
+  // this is only for points known to be well apart and in general position.
+  struct FastPredicates {
+    template <typename T>
+    static double orient(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c) {
+      return (static_cast<double>(a.x) - c.x) * (static_cast<double>(b.y) - c.y)
+        - (static_cast<double>(a.y) - c.y) * (static_cast<double>(b.x) - c.x);
+    }
+
+    template <typename T>
+    static double incircle(const BasicPoint<T>& a,
+        const BasicPoint<T>& b,
+        const BasicPoint<T>& c,
+        const BasicPoint<T>& d) {
+      double adx = static_cast<double>(a.x) - d.x, ady = static_cast<double>(a.y) - d.y;
+      double bdx = static_cast<double>(b.x) - d.x, bdy = static_cast<double>(b.y) - d.y;
+      double cdx = static_cast<double>(c.x) - d.x, cdy = static_cast<double>(c.y) - d.y;
+      return (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy)
+        + (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy)
+        + (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+    }
+  };
+
+  // Four triangles a, b, c side by side, lane i holding triangle i, so each
+  // coordinate loads straight into a vector register.
+  template <typename T>
+  struct BasicTriangles4 {
+    T ax[4];
+    T ay[4];
+    T bx[4];
+    T by[4];
+    T cx[4];
+    T cy[4];
+  };
+
+  typedef BasicTriangles4<float> Triangles4;
+
+  // The batched tests below run lane i on triangle i of tris and point
+  // x[i], y[i], which covers one point against four triangles as well as
+  // four points against one. Only the first count lanes are tested. Each
+  // returns a mask with bit i set where lane i passes, using AVX, SSE2 or
+  // NEON when built for them, and decides every lane exactly: the filter
+  // runs on all four at once and lanes within its error bound are
+  // recomputed exactly one by one, int32 ones with the integer tests.
+
+  // Whether the point is in the counter clockwise triangle, boundary
+  // included.
+  template <typename T>
+  unsigned in_triangle4(const BasicTriangles4<T>& tris, const T* x, const T* y, unsigned count);
+
+  // Whether the point is strictly inside the circle through the counter
+  // clockwise triangle.
+  template <typename T>
+  unsigned in_circle4(const BasicTriangles4<T>& tris, const T* x, const T* y, unsigned count);
+
+  // Whether the triangle is counter clockwise, the points are unused.
+  template <typename T>
+  unsigned ccw4(const BasicTriangles4<T>& tris, unsigned count);
+
+#ifdef DELAUNAY_PREDICATE_STATS
+  // How often each test ran and how often the filter wasn't enough.
+  struct PredicateStats {
+    uint64_t m_orient;
+    uint64_t m_orient_exact;
+    uint64_t m_incircle;
+    uint64_t m_incircle_exact;
+  };
+
+  // Totals since the last reset, over every thread.
+  PredicateStats predicate_stats();
+  void reset_predicate_stats();
+#endif
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "delaunay.h"
+
+// Binary snapshots of a triangulation that can be mapped into memory and
+// queried in place, so a finished triangulation comes back without being
+// rebuilt.
+//
+// A snapshot is a header followed by flat arrays, each starting at a
+// multiple of 64 bytes into the file:
+//
+//   points       m_vertex_count points, x then y, removed vertices included
+//                so ids match the triangulation's
+//   triangles    3 vertex ids per triangle, counter clockwise, in the order
+//                of get_indices
+//   neighbors    3 per triangle, the triangle across the edge from vertex i
+//                to vertex i + 1, no_triangle on the hull
+//   incident     a triangle around each vertex, no_triangle for vertices in
+//                none
+//   grid         a vertex in each cell of m_grid, no_vertex for empty ones
+//   constrained  with snapshot_constrained set, a byte per triangle with bit
+//                i set if the edge from vertex i is constrained
+//
+// Everything is little endian, the byte order of every platform built
+// for. Readers check the endian tag and refuse files from anything else.
+
+namespace delaunay {
+  const uint32_t snapshot_version = 1;
+
+  // Set in SnapshotHeader::m_flags if the constrained section is present.
+  const uint32_t snapshot_constrained = 1;
+
+  struct SnapshotHeader {
+    // "DELAUNAY"
+    char m_magic[8];
+    uint32_t m_version;
+    // 0x01020304 as written by the host.
+    uint32_t m_endian;
+    // 1 for float, 2 for double and 3 for int32 coordinates.
+    uint32_t m_scalar;
+    uint32_t m_flags;
+    uint32_t m_vertex_count;
+    uint32_t m_triangle_count;
+    GridShape m_grid;
+    // Byte offsets of the sections, 0 for one that is absent.
+    uint64_t m_points;
+    uint64_t m_triangles;
+    uint64_t m_neighbors;
+    uint64_t m_incident;
+    uint64_t m_cells;
+    uint64_t m_constrained;
+    // Of the whole file.
+    uint64_t m_size;
+    uint64_t m_reserved;
+  };
+
+  // Writes tria to the file at path front to back in one pass, streaming
+  // each section out of the triangulation. The grid is the one compact laid
+  // down, or a fresh one if there is none. Returns false if the file can't
+  // be written.
+  template <typename Traits>
+  bool write_snapshot(const BasicTriangulation<Traits>& tria, const char* path);
+
+  // A snapshot of a triangulation with T coordinates, mapped read only and
+  // queried where it lies. Opening checks the header and that the sections
+  // fit in the file, nothing is parsed or copied, so it costs the same for
+  // any size and pages are only read in as queries touch them. The contents
+  // are trusted past that.
+  template <typename T>
+  class BasicSnapshot {
+  public:
+    typedef BasicPoint<T> Point;
+
+    BasicSnapshot();
+    ~BasicSnapshot();
+
+    BasicSnapshot(const BasicSnapshot&) = delete;
+    BasicSnapshot& operator=(const BasicSnapshot&) = delete;
+
+    // Maps the file at path. Returns false, leaving the snapshot closed, if
+    // it can't be mapped or isn't a version snapshot_version snapshot with
+    // T coordinates. Platforms without mmap read the file into memory.
+    bool open(const char* path);
+
+    // Uses the size bytes at data in place, for snapshots already in
+    // memory. data must be 8 byte aligned and outlive the snapshot.
+    bool open(const void* data, size_t size);
+
+    void close();
+
+    bool is_open() const;
+
+    size_t vertex_count() const;
+    size_t triangle_count() const;
+
+    const Point* vertices() const;
+
+    // 3 vertex ids per triangle, counter clockwise.
+    const uint32_t* indices() const;
+
+    // 3 per triangle, the triangle across edge i or no_triangle.
+    const uint32_t* neighbors() const;
+
+    // Whether edge i of triangle t, from its vertex i to the next, is
+    // constrained.
+    bool is_constrained(uint32_t t, int edge) const;
+
+    // The triangle containing pt, one of them for a point on an edge, or
+    // no_triangle outside the hull. Walks from the grid cell of pt.
+    uint32_t find(const Point& pt) const;
+
+    // The vertex closest to pt, or no_vertex without triangles. Only exact
+    // for triangulations without constraints, like nearest.
+    uint32_t nearest(const Point& pt) const;
+
+  private:
+    // Sets up the section pointers if the size bytes at data are a valid
+    // snapshot, otherwise leaves the snapshot closed.
+    bool attach(const unsigned char* data, size_t size);
+
+    // A triangle near pt to start a walk at.
+    uint32_t start(const Point& pt) const;
+
+    // Whatever open mapped or read, released by close.
+    void* m_map;
+    size_t m_map_size;
+    std::vector<uint64_t> m_copy;
+
+    const SnapshotHeader* m_header;
+    const Point* m_points;
+    const uint32_t* m_triangles;
+    const uint32_t* m_neighbors;
+    const uint32_t* m_incident;
+    const uint32_t* m_cells;
+    const uint8_t* m_constrained;
+  };
+
+  typedef BasicSnapshot<float> Snapshot;
+  typedef BasicSnapshot<double> DoubleSnapshot;
+  typedef BasicSnapshot<int32_t> IntSnapshot;
+}
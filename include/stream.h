@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "delaunay.h"
+
+// Streaming construction after Isenburg, Liu, Shewchuk and Snoeyink,
+// "Streaming Computation of Delaunay Triangulations". Points arrive in
+// chunks over a grid of cells laid over bounds known up front, and the
+// stream says when each cell is finalized, that is gets no more points. A
+// triangle whose circumcircle only covers finalized cells can't be changed
+// by any point still to come, so it is handed to the sink and freed, and a
+// vertex goes once all of its triangles have. Only the front between
+// finalized and unfinalized space stays in memory, however long the stream.
+
+namespace delaunay {
+  // A triangle of a stream that hasn't been sent yet, or a ghost outside the
+  // hull. Across edge i lies m_neighbors[i], null once that triangle has
+  // been sent.
+  template <typename T>
+  struct BasicStreamNode {
+    BasicPoint<T> m_pts[3];
+    BasicStreamNode* m_neighbors[3];
+    // Vertex slots, recycled as vertices retire. infinite_vertex for the
+    // vertex at infinity.
+    uint32_t m_ids[3];
+    // Cell the triangle waits on, the first unfinalized one its
+    // circumcircle covers in row order, or the ghost list for ghosts.
+    uint32_t m_cell;
+    // Neighbors in the list of the cell it waits on.
+    BasicStreamNode* m_prev;
+    BasicStreamNode* m_next;
+
+    BasicStreamNode(const BasicPoint<T>& p1, const BasicPoint<T>& p2, const BasicPoint<T>& p3) {
+      m_pts[0] = p1;
+      m_pts[1] = p2;
+      m_pts[2] = p3;
+      m_neighbors[0] = m_neighbors[1] = m_neighbors[2] = nullptr;
+      m_ids[0] = m_ids[1] = m_ids[2] = 0;
+      m_cell = 0;
+      m_prev = m_next = nullptr;
+    };
+
+    bool is_ghost() const {
+      return m_ids[0] == infinite_vertex
+        || m_ids[1] == infinite_vertex
+        || m_ids[2] == infinite_vertex;
+    };
+  };
+
+  // Bowyer-Watson insertion over a stream of points with finalization, for
+  // any of the built in traits. Sends out the Delaunay triangulation of the
+  // points, up to the diagonal chosen among cocircular ones, each triangle
+  // as soon as it is final.
+  template <typename Traits>
+  class BasicStream {
+  public:
+    typedef typename Traits::Scalar Scalar;
+    typedef BasicPoint<Scalar> Point;
+    typedef BasicStreamNode<Scalar> StreamNode;
+
+    // Gets count finished triangles at a time, counter clockwise: the
+    // stream index of each corner in ids and its x, y in xy, 3 and 6 per
+    // triangle. Stream indices count every point passed to insert, dropped
+    // ones included.
+    typedef std::function<void(const uint64_t* ids, const Scalar* xy, size_t count)> Sink;
+
+    // Pulls up to capacity points into xy, x then y, returning how many it
+    // wrote and 0 at the end of the stream.
+    typedef std::function<size_t(Scalar* xy, size_t capacity)> Reader;
+
+    // Streams points inside the box from min to max, cut into columns by
+    // rows cells.
+    BasicStream(const Point& min, const Point& max, uint32_t columns, uint32_t rows, Sink sink);
+
+    BasicStream(const BasicStream&) = delete;
+    BasicStream& operator=(const BasicStream&) = delete;
+
+    // Index of the cell pt is in, row after row, so a first pass over the
+    // points can count them for expect. Points outside the box get the
+    // cell count.
+    size_t cell(const Point& pt) const;
+
+    size_t cell_count() const;
+
+    // Finalizes each cell once it has been sent counts[cell] points, right
+    // away for cells expecting none. The finalization tags of the paper,
+    // counted up front instead of stored in the stream.
+    void expect(const uint64_t* counts);
+
+    // Adds the count points read from xy, each stride bytes after the
+    // previous one. Points outside the box or in a finalized cell, and
+    // duplicates within the traits' tolerance, are dropped. Triangles that
+    // became final are sent before returning.
+    void insert(const Scalar* xy, size_t count, size_t stride);
+
+    // Promises cell gets no more points and sends whatever that finishes.
+    void finalize(size_t cell);
+
+    // Finalizes every cell left, which sends every remaining triangle and
+    // frees everything. Nothing can be added after.
+    void finish();
+
+    // Inserts chunks of up to chunk points from read until it runs dry,
+    // then finishes.
+    void run(const Reader& read, size_t chunk);
+
+    // Points dropped so far.
+    size_t dropped() const;
+
+    // Triangles in memory now and at most so far, ghosts included.
+    size_t active_triangles() const;
+    size_t peak_triangles() const;
+
+    // Bytes held by the triangles, the vertices and the cells.
+    size_t bytes() const;
+
+  private:
+    struct Vertex {
+      Point m_pt;
+      uint64_t m_index;
+      // Triangles around the vertex still in memory, ghosts included. The
+      // slot is recycled when this reaches 0.
+      uint32_t m_count;
+    };
+
+    // Slot for a vertex at pt with stream index index.
+    uint32_t add_vertex(const Point& pt, uint64_t index);
+
+    // Adds the point with stream index index, unless it is dropped.
+    void add(const Point& pt, uint64_t index);
+
+    // Triangulates the pending points once they are not all on one line.
+    void flush_pending();
+
+    // The first triangle a, b, c and a ghost on each of its edges.
+    void start(uint32_t a, uint32_t b, uint32_t c);
+
+    // Bowyer-Watson insertion of vertex id. Returns false, changing
+    // nothing, if it is within the tolerance of a vertex of its cavity.
+    bool insert_cavity(uint32_t id);
+
+    // A live triangle or ghost whose circumcircle holds pt, walking from
+    // m_last and scanning every live triangle if the walk runs into sent
+    // ones. nullptr if there is none, pt being an existing vertex.
+    StreamNode* locate(const Point& pt);
+
+    // Whether pt is strictly inside node's circumcircle, or beyond a
+    // ghost's hull edge.
+    static bool conflicts(const StreamNode* node, const Point& pt);
+
+    static bool equal(const Point& p1, const Point& p2);
+
+    StreamNode* make_node(uint32_t a, uint32_t b, uint32_t c);
+
+    // Unlinks node from its cell's list and frees it. send says whether it
+    // is final and goes to the sink first.
+    void release(StreamNode* node, bool send);
+
+    // Puts node in the list of the first unfinalized cell its circumcircle
+    // covers from cell from on, or sends it if there is none.
+    void wait(StreamNode* node, uint32_t from);
+
+    // Hands the buffered triangles to the sink.
+    void flush();
+
+    typename Traits::template Allocator<StreamNode> m_nodes;
+    std::vector<Vertex> m_vertices;
+    std::vector<uint32_t> m_free;
+    // Vertices waiting for a triangle, all on one line.
+    std::vector<uint32_t> m_pending;
+
+    Point m_min;
+    Point m_max;
+    uint32_t m_columns;
+    uint32_t m_rows;
+    double m_scale_x;
+    double m_scale_y;
+    std::vector<bool> m_finalized;
+    // Points each cell still expects, empty without expect.
+    std::vector<uint64_t> m_expected;
+    // Head of each cell's list of waiting triangles, and of the ghosts'
+    // after the last cell.
+    std::vector<StreamNode*> m_waiting;
+
+    // Where the next walk starts, null if that triangle was sent.
+    StreamNode* m_last;
+    uint32_t m_seed;
+    uint64_t m_index;
+    size_t m_dropped;
+    size_t m_active;
+    size_t m_peak;
+
+    Sink m_sink;
+    std::vector<uint64_t> m_out_ids;
+    std::vector<Scalar> m_out_xy;
+
+    // Scratch space for insert_cavity.
+    std::vector<StreamNode*> m_cavity;
+    std::vector<StreamNode*> m_fan;
+  };
+
+  typedef BasicStream<FloatTraits> Stream;
+  typedef BasicStream<DoubleTraits> DoubleStream;
+  typedef BasicStream<IntTraits> IntStream;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "delaunay.h"
+
+// Voronoi diagram as the dual of the triangulation. Each leaf triangle's
+// circumcenter is a corner of the cells of its three vertices, and going
+// around a vertex through its triangles visits the corners of its cell in
+// order.
+
+namespace delaunay {
+  // Every cell as a polygon, in flat arrays. The corners of the cell of
+  // vertex id are m_x[i], m_y[i] for i from m_offsets[id] up to
+  // m_offsets[id + 1], counter clockwise. Removed vertices, and every vertex
+  // while all of them are on one line, have no corners. T is the
+  // triangulation's coordinate type.
+  template <typename T>
+  struct BasicVoronoi {
+    // Circumcenter of every leaf triangle, in the order of get_indices.
+    std::vector<T> m_center_x;
+    std::vector<T> m_center_y;
+
+    std::vector<uint32_t> m_offsets;
+    std::vector<T> m_x;
+    std::vector<T> m_y;
+  };
+
+  typedef BasicVoronoi<float> Voronoi;
+
+  // Fills out with the cell of every vertex of tria clipped to the box
+  // from min to max. The circumcenters are computed once per triangle and
+  // the cells assembled from them, both on up to threads threads, 0 using
+  // every hardware thread. Cells of hull vertices are unbounded, so they
+  // are cut out of the box by the bisectors with their neighbors instead.
+  // Built for the float and double traits, circumcenters don't land on an
+  // integer grid.
+  template <typename Traits>
+  void voronoi(const BasicTriangulation<Traits>& tria,
+    const BasicPoint<typename Traits::Scalar>& min,
+    const BasicPoint<typename Traits::Scalar>& max,
+    unsigned threads,
+    BasicVoronoi<typename Traits::Scalar>& out);
+}
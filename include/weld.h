@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "delaunay.h"
+
+// Duplicate removal ahead of triangulation.
+
+namespace delaunay {
+  // Welds the count float, double or int32 points in xy, spaced stride
+  // bytes apart, that are closer than tolerance along both axes, the test
+  // insert uses for duplicates. Points are taken in order and each either
+  // merges into the first kept point that close or is kept itself. Kept
+  // points are hashed into a grid of cells twice the tolerance wide, so a
+  // point only checks the four cells that can hold such a neighbor, O(1)
+  // expected time per point. Fills remap with the index of the kept point
+  // each point merged into, its own for kept points, and returns how many
+  // were kept. tolerance must be positive.
+  template <typename T>
+  size_t weld(const T* xy,
+    size_t count,
+    size_t stride,
+    double tolerance,
+    std::vector<uint32_t>& remap);
+}
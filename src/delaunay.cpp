@@ -3,302 +3,1839 @@
 #include <algorithm>
 #include <cfloat>
 #include <cmath>
-#include <iostream>
+#include <functional>
+#include <limits>
+
+#include "divide.h"
+#include "order.h"
+#include "parallel.h"
+#include "predicates.h"
+#include "weld.h"
 
 namespace delaunay {
 
+// Stands in for the coordinates of the vertex at infinity. Compares unequal
+// to everything, and ghosts are never handed to the predicates with it.
+template <typename T>
+BasicPoint<T> infinity() {
+  T v = std::numeric_limits<T>::has_quiet_NaN ? std::numeric_limits<T>::quiet_NaN() : std::numeric_limits<T>::min();
+  return BasicPoint<T>(v, v);
+}
 
-// Temp.
-Point b1(20.0f, -20.0f);
-Point b2(-20.0f, -20.0f);
+// Below this many queries per thread a batch runs on fewer threads.
+const size_t s_queries_per_thread = 1 << 12;
 
-Point sub(const Point& p1, const Point& p2) {
-  return Point(p1.x - p2.x, p1.y - p2.y);
+// xorshift, good enough to randomize which edge a walk tries first.
+uint32_t next_random(uint32_t& seed) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
 }
 
-float dot(const Point& p1, const Point& p2) {
-  return p1.x * p2.x + p1.y * p2.y;
+// Offset of the center of the circle through a, b and c from a. Solving
+// relative to a keeps the terms small. false if they are on one line.
+template <typename T>
+bool center_offset(const BasicPoint<T>& a,
+    const BasicPoint<T>& b,
+    const BasicPoint<T>& c,
+    double& x,
+    double& y) {
+  double bx = static_cast<double>(b.x) - a.x, by = static_cast<double>(b.y) - a.y;
+  double cx = static_cast<double>(c.x) - a.x, cy = static_cast<double>(c.y) - a.y;
+  double d = 2.0 * (bx * cy - by * cx);
+  if (d == 0.0) return false;
+
+  double b2 = bx * bx + by * by;
+  double c2 = cx * cx + cy * cy;
+  x = (cy * b2 - by * c2) / d;
+  y = (bx * c2 - cx * b2) / d;
+  return true;
 }
 
-// Default epsilon assumes two points of distance .001 apart can be considered the same.
-bool equal(const Point& p1, const Point& p2, float epsilon=0.001f) {
-  return fabs(p1.x - p2.x) < epsilon && fabs(p1.y - p2.y) < epsilon;
+// Whether p is on the same side of a as b, with a, p, b on one line.
+template <typename T>
+bool ahead(const BasicPoint<T>& a, const BasicPoint<T>& p, const BasicPoint<T>& b) {
+  return (static_cast<double>(p.x) - a.x) * (static_cast<double>(b.x) - a.x)
+    + (static_cast<double>(p.y) - a.y) * (static_cast<double>(b.y) - a.y) > 0;
 }
 
-bool vert_in(const Point& p, Point* pts) {
-  return equal(p, pts[0]) || equal(p, pts[1]) || equal(p, pts[2]);
+// Threads for a batch of count queries, each given at least
+// s_queries_per_thread of them.
+unsigned query_threads(size_t count, unsigned threads) {
+  return static_cast<unsigned>(std::max<size_t>(1,
+    std::min<size_t>(thread_count(threads), count / s_queries_per_thread)));
+}
+
+// Squared distance between a and b.
+template <typename T>
+double distance2(const BasicPoint<T>& a, const BasicPoint<T>& b) {
+  double x = static_cast<double>(a.x) - b.x;
+  double y = static_cast<double>(a.y) - b.y;
+  return x * x + y * y;
+}
+
+// Key of the edge between a and b in either direction.
+uint64_t edge_key(uint32_t a, uint32_t b) {
+  if (a > b) std::swap(a, b);
+  return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+// Puts the triangle pts in lane i of tris.
+template <typename T>
+void set_lane(BasicTriangles4<T>& tris, unsigned i, const BasicPoint<T>* pts) {
+  tris.ax[i] = pts[0].x;
+  tris.ay[i] = pts[0].y;
+  tris.bx[i] = pts[1].x;
+  tris.by[i] = pts[1].y;
+  tris.cx[i] = pts[2].x;
+  tris.cy[i] = pts[2].y;
 }
 
-bool point_in_tri(const Point& pt, Point* pts) {
-  Point v0 = sub(pts[2], pts[0]);
-  Point v1 = sub(pts[1], pts[0]);
-  Point v2 = sub(pt, pts[0]);
+// Whether node is one of the handful in nodes.
+template <typename Node>
+bool in(const std::vector<Node*>& nodes, const Node* node) {
+  return std::find(nodes.begin(), nodes.end(), node) != nodes.end();
+}
+
+// Index of the edge of node shared with neighbor.
+template <typename Node>
+int edge_of(const Node* node, const Node* neighbor) {
+  if (node->m_neighbors[0] == neighbor) return 0;
+  if (node->m_neighbors[1] == neighbor) return 1;
+  return 2;
+}
+
+// Points node's link to old_neighbor at new_neighbor instead.
+template <typename Node>
+void relink(Node* node, const Node* old_neighbor, Node* new_neighbor) {
+  if (!node) return;
+  node->m_neighbors[edge_of(node, old_neighbor)] = new_neighbor;
+}
 
-  float dot00 = dot(v0, v0);
-  float dot01 = dot(v0, v1);
-  float dot02 = dot(v0, v2);
-  float dot11 = dot(v1, v1);
-  float dot12 = dot(v1, v2);
+template <typename Traits>
+bool BasicTriangulation<Traits>::equal(const Point& p1, const Point& p2) {
+  return std::fabs(static_cast<double>(p1.x) - p2.x) < Traits::tolerance()
+    && std::fabs(static_cast<double>(p1.y) - p2.y) < Traits::tolerance();
+}
 
-  float inv_d = 1.0f / (dot00 * dot11 - dot01 * dot01);
-  float u = (dot11 * dot02 - dot01 * dot12) * inv_d;
-  float v = (dot00 * dot12 - dot01 * dot02) * inv_d;
+template <typename Traits>
+bool BasicTriangulation<Traits>::vert_in(const Point& p, const Point* pts) {
+  return equal(p, pts[0]) || equal(p, pts[1]) || equal(p, pts[2]);
+}
 
-  return (u >= 0) && (v >= 0) && (u + v < 1);
+template <typename Traits>
+bool BasicTriangulation<Traits>::point_in_tri(const Point& pt, const Point* pts) {
+  return orient(pts[0], pts[1], pt) >= 0
+    && orient(pts[1], pts[2], pt) >= 0
+    && orient(pts[2], pts[0], pt) >= 0;
 }
 
-bool point_in_circle(const Point& pt,
+template <typename Traits>
+bool BasicTriangulation<Traits>::point_in_circle(const Point& pt,
     const Point& a,
     const Point& b,
     const Point& c) {
-  // http://paulbourke.net/geometry/circlesphere/ 
-  float ma = (b.y - a.y) /  (b.x - a.x);
-  float mb = (c.y - b.y) /  (c.x - b.x);
-  float x = (ma * mb * (a.y - c.y) + mb * (a.x + b.x) - ma * (b.x + c.x)) / (2 * (mb - ma));
-  float y = (-1.0f / ma) * (x - (a.x + b.x) / 2.0f) + ((a.y + b.y) / 2.0f);
+  return incircle(a, b, c, pt) > 0;
+}
 
-  Point cen(x, y);
-  Point r_diff = sub(a, cen);
-  float dot_diff = dot(r_diff, r_diff);
-  Point p_diff = sub(pt, cen);
-  float p_dot = dot(p_diff, p_diff);
+template <typename Traits>
+bool BasicTriangulation<Traits>::conflicts(const TriNode* node, const Point& pt) {
+  int g = 0;
+  while (g < 3 && node->m_ids[g] != infinite_vertex) ++g;
+  if (g == 3) return point_in_circle(pt, node->m_pts[0], node->m_pts[1], node->m_pts[2]);
 
-  return p_dot < dot_diff;
+  const Point& a = node->m_pts[(g + 1) % 3];
+  const Point& b = node->m_pts[(g + 2) % 3];
+  double o = orient(a, b, pt);
+  if (o != 0) return o > 0;
+  if (a.x != b.x) return std::min(a.x, b.x) < pt.x && pt.x < std::max(a.x, b.x);
+  return std::min(a.y, b.y) < pt.y && pt.y < std::max(a.y, b.y);
 }
 
-Triangulation::Triangulation(const Point& p1, 
-    const Point& p2, 
-    const Point p3, 
-    const std::vector<Point>& ps) : m_points(ps) {
-  m_root = new TriNode(p1, p2, p3);
+template <typename Traits>
+BasicTriangulation<Traits>::BasicTriangulation() : m_history(true),
+    m_locate(Locate::history),
+    m_kernel(Kernel::flip),
+    m_last(nullptr),
+    m_seed(2463534242u),
+    m_welded(false) {
 }
 
-Triangulation::~Triangulation() {
-  //recursive_delete(m_root);
+template <typename Traits>
+uint32_t BasicTriangulation<Traits>::insert(const Point& pt) {
+  uint32_t id = add_vertex(pt);
+  if (place(id)) return id;
+
+  m_points.pop_back();
+  m_incident.pop_back();
+  return no_vertex;
 }
 
-TriNode* Triangulation::insert(const Point& pt) {
-  std::vector<TriNode*> nodes;
-  std::set<TriNode*> added;
-  find(pt, m_root, nodes, added);
-  // There should only be a single triangle containing this point, otherwise
-  // it was likely an existing vertex.
-  if (nodes.size() != 1) return nullptr;
-  TriNode* node = nodes.front();
-  // Create three new triangles with the given point.
-  node->m_children[0] = new TriNode(pt, node->m_pts[0], node->m_pts[1]);
-  node->m_children[1] = new TriNode(pt, node->m_pts[1], node->m_pts[2]);
-  node->m_children[2] = new TriNode(pt, node->m_pts[2], node->m_pts[0]);
+template <typename Traits>
+uint32_t BasicTriangulation<Traits>::add_vertex(const Point& pt) {
+  m_points.push_back(pt);
+  m_incident.push_back(nullptr);
+  return static_cast<uint32_t>(m_points.size() - 1);
+}
 
-  return node;
+template <typename Traits>
+bool BasicTriangulation<Traits>::place(uint32_t id) {
+  const Point& pt = m_points[id];
+  if (m_leaves.empty()) {
+    for (uint32_t i : m_pending) {
+      if (equal(pt, m_points[i])) return false;
+    }
+    m_pending.push_back(id);
+    flush_pending();
+    return true;
+  }
+
+  TriNode* node = locate(pt);
+  if (!node) return false;
+  link(node, id);
+  return true;
 }
 
-TriNode* Triangulation::split(const Point& p1, const Point& p2) {
-  std::vector<TriNode*> nodes;
-  find_by_edge(p1, p2, m_root, nodes);
-  // We can only split a convex quadrilateral.
-  if (nodes.size() != 2) return nullptr;
-  TriNode* n1 = nodes[0];
-  TriNode* n2 = nodes[1];
+template <typename Traits>
+void BasicTriangulation<Traits>::flush_pending() {
+  size_t k = 2;
+  while (k < m_pending.size()
+      && orient(m_points[m_pending[0]], m_points[m_pending[1]], m_points[m_pending[k]]) == 0) {
+    ++k;
+  }
+  if (k >= m_pending.size()) return;
 
-  Point p3, p4;
-  for (int i = 0; i < 3; ++i) {
-    if (!vert_in(n2->m_pts[i], n1->m_pts)) {
-      p3 = n2->m_pts[i]; 
+  // The rest are on the line through the first two, so they go in after
+  // the triangle those two make with the first point off it.
+  start(m_pending[0], m_pending[1], m_pending[k]);
+  for (size_t i = 2; i < m_pending.size(); ++i) {
+    if (i == k) continue;
+    TriNode* node = locate(m_points[m_pending[i]]);
+    if (node) link(node, m_pending[i]);
+  }
+  m_pending.clear();
+}
+
+template <typename Traits>
+bool BasicTriangulation<Traits>::remove(uint32_t id) {
+  if (id >= m_points.size()) return false;
+  std::vector<uint32_t>::iterator pending = std::find(m_pending.begin(), m_pending.end(), id);
+  if (pending != m_pending.end()) {
+    m_pending.erase(pending);
+    return true;
+  }
+
+  TriNode* node = m_incident[id];
+  if (!node) return false;
+  drop_history();
+  size_t real = star(id);
+  m_incident[id] = nullptr;
+  for (uint32_t v : m_link) {
+    if (!m_fixed.empty()) m_fixed.erase(edge_key(id, v));
+  }
+
+  if (real == m_leaves.size()) {
+    // Every triangle had id as a corner, so what is left is the link and
+    // may be on one line. Start over from it.
+    m_nodes.clear();
+    m_leaves.clear();
+    m_fixed.clear();
+    m_last = nullptr;
+    for (uint32_t v : m_link) {
+      if (v == infinite_vertex) continue;
+      m_incident[v] = nullptr;
+      m_pending.push_back(v);
     }
+    flush_pending();
+    return true;
+  }
 
-    if (!vert_in(n1->m_pts[i], n2->m_pts)) {
-      p4 = n1->m_pts[i]; 
+  fill_hole();
+  for (TriNode* s : m_cavity) {
+    remove_leaf(s);
+    m_nodes.destroy(s);
+  }
+  m_edges.clear();
+  for (TriNode* f : m_fan) {
+    for (int e = 0; e < 3; ++e) m_edges.push_back(std::make_pair(f, e));
+  }
+  restore();
+
+  // The walk needs somewhere to start, next to the hole is as good as any.
+  walk_from(m_link[0] == infinite_vertex ? m_link[1] : m_link[0]);
+  return true;
+}
+
+template <typename Traits>
+bool BasicTriangulation<Traits>::remove(const Point& pt) {
+  uint32_t id = vertex_near(pt);
+  return id != no_vertex && remove(id);
+}
+
+template <typename Traits>
+uint32_t BasicTriangulation<Traits>::vertex_near(const Point& pt) {
+  for (uint32_t i : m_pending) {
+    if (equal(pt, m_points[i])) return i;
+  }
+  if (m_leaves.empty()) return no_vertex;
+
+  // Outside the hull the ghost's hull edge has the closest vertices.
+  std::vector<TriNode*> nodes;
+  find(pt, nodes);
+  if (nodes.empty()) nodes.push_back(walk(pt, start_near(pt), m_seed));
+  for (TriNode* node : nodes) {
+    for (int i = 0; i < 3; ++i) {
+      if (equal(pt, node->m_pts[i])) return node->m_ids[i];
     }
   }
+  return no_vertex;
+}
+
+template <typename Traits>
+bool BasicTriangulation<Traits>::insert_segment(uint32_t a, uint32_t b) {
+  if (a >= m_points.size() || b >= m_points.size()) return false;
+  if (!m_incident[a] || !m_incident[b]) return false;
+  return constrain(a, b);
+}
+
+template <typename Traits>
+bool BasicTriangulation<Traits>::insert_segment(const Point& a, const Point& b) {
+  uint32_t ids[2];
+  const Point* ends[2] = { &a, &b };
+  for (int i = 0; i < 2; ++i) {
+    ids[i] = insert(*ends[i]);
+    if (ids[i] == no_vertex) ids[i] = vertex_near(*ends[i]);
+    if (ids[i] == no_vertex) return false;
+  }
+  return insert_segment(ids[0], ids[1]);
+}
 
-  if (!point_in_circle(p4, n2->m_pts[0], n2->m_pts[1], n2->m_pts[2]) && 
-      !point_in_circle(p3, n1->m_pts[0], n1->m_pts[1], n1->m_pts[2])) {
-    return nullptr;
+template <typename Traits>
+size_t BasicTriangulation<Traits>::insert_segments(const uint32_t* ends, size_t count) {
+  size_t inserted = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (insert_segment(ends[2 * i], ends[2 * i + 1])) ++inserted;
   }
+  return inserted;
+}
 
-  TriNode* t1 = new TriNode(p1, p3, p4);
-  TriNode* t2 = new TriNode(p2, p4, p3);
+template <typename Traits>
+bool BasicTriangulation<Traits>::is_constrained(uint32_t a, uint32_t b) const {
+  return !m_fixed.empty() && m_fixed.count(edge_key(a, b));
+}
 
-  n1->m_children[0] = t1;
-  n2->m_children[0] = t1;
+template <typename Traits>
+typename BasicTriangulation<Traits>::TriNode* BasicTriangulation<Traits>::find_edge(uint32_t u, uint32_t v, int& edge) const {
+  TriNode* first = m_incident[u];
+  TriNode* t = first;
+  do {
+    int i = 0;
+    while (t->m_ids[i] != u) ++i;
+    if (t->m_ids[(i + 1) % 3] == v) {
+      edge = i;
+      return t;
+    }
+    t = t->m_neighbors[(i + 2) % 3];
+  } while (t != first);
+  return nullptr;
+}
 
-  n1->m_children[1] = t2;
-  n2->m_children[1] = t2;
+template <typename Traits>
+bool BasicTriangulation<Traits>::constrain(uint32_t a, uint32_t b) {
+  while (a != b) {
+    const Point pa = m_points[a];
+    const Point pb = m_points[b];
 
-  n1->m_children[2] = nullptr;
-  n2->m_children[2] = nullptr;
+    // Go around a to the triangle the segment leaves a through, or to the
+    // edge it runs along.
+    TriNode* first = m_incident[a];
+    TriNode* t = first;
+    uint32_t stop = no_vertex;
+    int edge = -1;
+    m_edges.clear();
+    do {
+      int i = 0;
+      while (t->m_ids[i] != a) ++i;
+      uint32_t u = t->m_ids[(i + 1) % 3];
+      uint32_t v = t->m_ids[(i + 2) % 3];
+      if (u != infinite_vertex) {
+        const Point& pu = m_points[u];
+        double o = orient(pa, pu, pb);
+        if (u == b || (o == 0 && ahead(pa, pu, pb))) {
+          stop = u;
+          break;
+        }
+        if (!t->is_ghost() && o > 0 && orient(pa, m_points[v], pb) < 0) {
+          edge = (i + 1) % 3;
+          break;
+        }
+      }
+      t = t->m_neighbors[(i + 2) % 3];
+    } while (t != first);
 
-  return n1;
+    if (stop == no_vertex) {
+      if (edge < 0) return false;
+
+      // Collect the edges the segment crosses up to b or the first vertex
+      // on it. Each runs from the right of the segment to the left.
+      m_crossed.clear();
+      for (;;) {
+        uint32_t u = t->m_ids[edge];
+        uint32_t v = t->m_ids[(edge + 1) % 3];
+        if (is_constrained(u, v)) {
+          // Two constraints cross, split both where they meet.
+          const Point& pu = m_points[u];
+          const Point& pv = m_points[v];
+          double ou = orient(pa, pb, pu);
+          double s = ou / (ou - orient(pa, pb, pv));
+          Point x(static_cast<Scalar>(pu.x + s * (static_cast<double>(pv.x) - pu.x)),
+            static_cast<Scalar>(pu.y + s * (static_cast<double>(pv.y) - pu.y)));
+          // Without its constraint u-v is the one edge that may stop being
+          // Delaunay. Legalize it first, x can land on an existing vertex
+          // and then no insertion would. The history would have to search
+          // every triangle these flips leave x on the edge of, so walk.
+          drop_history();
+          m_fixed.erase(edge_key(u, v));
+          m_edges.clear();
+          m_edges.push_back(std::make_pair(t, edge));
+          restore();
+          walk_from(u);
+          uint32_t id = insert(x);
+          if (id == no_vertex) id = vertex_near(x);
+          if (id == no_vertex) return false;
+          // The new vertex is only close to both segments, so the rest of
+          // this one has to run through it too.
+          if (!constrain(u, id) || !constrain(id, v) || !constrain(a, id)) return false;
+          a = id;
+          break;
+        }
+        m_crossed.push_back(std::make_pair(u, v));
+
+        TriNode* n = t->m_neighbors[edge];
+        int j = edge_of(n, t);
+        uint32_t w = n->m_ids[(j + 2) % 3];
+        double o = w == b ? 0 : orient(pa, pb, m_points[w]);
+        if (o == 0) {
+          stop = w;
+          break;
+        }
+        t = n;
+        edge = o > 0 ? (j + 1) % 3 : (j + 2) % 3;
+      }
+      if (stop == no_vertex) continue;
+
+      // Flip the crossing edges away after Sloan. An edge whose
+      // quadrilateral isn't convex waits for its neighbors to go first,
+      // and a new edge that still crosses the segment goes round again.
+      const Point& ps = m_points[stop];
+      m_cavity.clear();
+      m_flipped.clear();
+      for (size_t k = 0; k < m_crossed.size(); ++k) {
+        std::pair<uint32_t, uint32_t> crossed = m_crossed[k];
+        uint32_t u = crossed.first;
+        uint32_t v = crossed.second;
+        TriNode* node = find_edge(u, v, edge);
+        TriNode* n = node->m_neighbors[edge];
+        uint32_t c = node->m_ids[(edge + 2) % 3];
+        uint32_t d = n->m_ids[(edge_of(n, node) + 2) % 3];
+        const Point& pc = m_points[c];
+        const Point& pd = m_points[d];
+        double ou = orient(pc, pd, m_points[u]);
+        double ov = orient(pc, pd, m_points[v]);
+        if (!((ou > 0 && ov < 0) || (ou < 0 && ov > 0))) {
+          m_crossed.push_back(crossed);
+          continue;
+        }
+
+        TriNode* t1;
+        TriNode* t2;
+        flip(node, edge, t1, t2);
+        m_cavity.push_back(node);
+        m_cavity.push_back(n);
+        double oc = orient(pa, ps, pc);
+        double od = orient(pa, ps, pd);
+        if ((oc > 0 && od < 0) || (oc < 0 && od > 0)) {
+          m_crossed.push_back(std::make_pair(c, d));
+        }
+        else {
+          m_flipped.push_back(std::make_pair(c, d));
+        }
+      }
+      if (!m_history) {
+        for (TriNode* dead : m_cavity) m_nodes.destroy(dead);
+      }
+
+      // The new edges off the segment may not be Delaunay.
+      for (const std::pair<uint32_t, uint32_t>& e : m_flipped) {
+        if (e.first == a && e.second == stop) continue;
+        if (e.first == stop && e.second == a) continue;
+        TriNode* node = find_edge(e.first, e.second, edge);
+        m_edges.push_back(std::make_pair(node, edge));
+      }
+    }
+
+    m_fixed.insert(edge_key(a, stop));
+    restore();
+    walk_from(stop);
+    a = stop;
+  }
+  return true;
 }
 
-std::vector<float> Triangulation::get_tris() {
-  std::vector<float> tris;
-  std::set<TriNode*> visited;
-  get_triangulation(m_root, tris, visited);
-  return tris;
+template <typename Traits>
+bool BasicTriangulation<Traits>::move_vertex(uint32_t id, const Point& pos) {
+  return move_vertices(&id, &pos, 1) == 1;
 }
 
-void Triangulation::find(const Point& pt, std::vector<TriNode*>& nodes) {
-  std::set<TriNode*> added;
-  find(pt, m_root, nodes, added);
+template <typename Traits>
+size_t BasicTriangulation<Traits>::move_vertices(const uint32_t* ids,
+    const Point* positions,
+    size_t count,
+    std::vector<uint32_t>* lost) {
+  size_t moved = 0;
+  // Two vertices headed for the same spot can't both get there, the later
+  // one stays put.
+  std::vector<uint32_t> first;
+  if (count > 1) weld(&positions[0].x, count, sizeof(Point), Traits::tolerance(), first);
+
+  // Indices of the moves that need a remove and insert, the position each
+  // vertex had before, and where the new ones go.
+  std::vector<uint32_t> later;
+  std::vector<Point> old;
+  std::vector<Point> pts;
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t id = ids[i];
+    if (id >= m_points.size()) continue;
+    if (!m_incident[id] && std::find(m_pending.begin(), m_pending.end(), id) == m_pending.end()) {
+      continue;
+    }
+    if (positions[i] == m_points[id]) {
+      ++moved;
+      continue;
+    }
+    if (!first.empty() && first[i] != i) continue;
+    if (m_incident[id] && shift(id, positions[i])) {
+      ++moved;
+      continue;
+    }
+
+    // Refused before anything changes if the spot is taken.
+    uint32_t near = vertex_near(positions[i]);
+    if (near != no_vertex && near != id) continue;
+
+    // Out of the way before any comes back, so none is held back by where
+    // another one was.
+    Point from = m_points[id];
+    if (!remove(id)) continue;
+    later.push_back(static_cast<uint32_t>(i));
+    old.push_back(from);
+    pts.push_back(positions[i]);
+  }
+  if (later.empty()) return moved;
+
+  // Consecutive vertices land next to each other, which keeps the walks
+  // short.
+  std::vector<uint32_t> order;
+  brio(&pts[0].x, pts.size(), sizeof(Point), Curve::hilbert, 1, order);
+  std::vector<uint32_t> failed;
+  for (uint32_t j : order) {
+    uint32_t id = ids[later[j]];
+    m_points[id] = pts[j];
+    if (place(id)) ++moved;
+    else failed.push_back(j);
+  }
+
+  // Taken spots send the vertex back where it came from, unless that has
+  // been taken meanwhile too.
+  for (uint32_t j : failed) {
+    uint32_t id = ids[later[j]];
+    m_points[id] = old[j];
+    if (!place(id) && lost) lost->push_back(id);
+  }
+  return moved;
 }
 
-void Triangulation::find(const Point& pt, 
-    TriNode* node, 
-    std::vector<TriNode*>& nodes,
-    std::set<TriNode*>& added) {
-  bool contains = vert_in(pt, node->m_pts) || point_in_tri(pt, node->m_pts);
-  if (!contains) return;
-  contains = false;
+template <typename Traits>
+size_t BasicTriangulation<Traits>::star(uint32_t id) {
+  m_cavity.clear();
+  m_link.clear();
+  m_outer.clear();
+  size_t real = 0;
+  TriNode* node = m_incident[id];
+  TriNode* t = node;
+  do {
+    int i = 0;
+    while (t->m_ids[i] != id) ++i;
+    m_cavity.push_back(t);
+    m_link.push_back(t->m_ids[(i + 1) % 3]);
+    m_outer.push_back(t->m_neighbors[(i + 1) % 3]);
+    if (!t->is_ghost()) ++real;
+    t = t->m_neighbors[(i + 2) % 3];
+  } while (t != node);
+  return real;
+}
 
-  for (int i = 0; i < 3; ++i) {
-    if (node->m_children[i]) {
-      contains = true;
-      find(pt, node->m_children[i], nodes, added);
+template <typename Traits>
+bool BasicTriangulation<Traits>::shift(uint32_t id, const Point& pos) {
+  star(id);
+  size_t k = m_link.size();
+  for (size_t i = 0; i < k; ++i) {
+    uint32_t a = m_link[i];
+    uint32_t b = m_link[(i + 1) % k];
+    if (a != infinite_vertex && equal(pos, m_points[a])) return false;
+    if (a == infinite_vertex || b == infinite_vertex) continue;
+    if (orient(m_points[a], m_points[b], pos) <= 0) return false;
+  }
+
+  // On the hull id sits between a and b, which must not dent it either.
+  size_t g = std::find(m_link.begin(), m_link.end(), infinite_vertex) - m_link.begin();
+  if (g < k) {
+    uint32_t a = m_link[(g + k - 1) % k];
+    uint32_t b = m_link[(g + 1) % k];
+    const TriNode* before = m_outer[(g + k - 1) % k];
+    const TriNode* after = m_outer[g];
+    int i = 0, j = 0;
+    while (before->m_ids[i] != a) ++i;
+    while (after->m_ids[j] != b) ++j;
+    const Point& p = m_points[before->m_ids[(i + 1) % 3]];
+    const Point& q = m_points[after->m_ids[(j + 2) % 3]];
+    if (orient(p, m_points[a], pos) <= 0
+        || orient(m_points[a], pos, m_points[b]) <= 0
+        || orient(pos, m_points[b], q) <= 0) {
+      return false;
     }
   }
 
-  // If this node was a leaf add it to the list.
-  if (!contains && added.find(node) == added.end()) {
-    nodes.push_back(node);
-    added.insert(node);
+  // The star keeps its shape, only its link edges and the edges out of id
+  // may have stopped being Delaunay. Each triangle brings its link edge
+  // and the edge it shares with the one before.
+  drop_history();
+  m_points[id] = pos;
+  m_edges.clear();
+  for (TriNode* t : m_cavity) {
+    int i = 0;
+    while (t->m_ids[i] != id) ++i;
+    t->m_pts[i] = pos;
+    m_edges.push_back(std::make_pair(t, i));
+    m_edges.push_back(std::make_pair(t, (i + 1) % 3));
   }
+  restore();
+  walk_from(id);
+  return true;
 }
 
-// Find all triangles containing both p1 and p2.
-void Triangulation::find_by_edge(const Point& p1,
-    const Point& p2,
-    TriNode* node,
-    std::vector<TriNode*>& nodes) {
-  std::vector<TriNode*> n1;
-  std::set<TriNode*> added;
-  find(p1, m_root, n1, added);
-  for (auto& n : n1) {
-    if (vert_in(p1, n->m_pts) && vert_in(p2, n->m_pts)) {
-      nodes.push_back(n);
+template <typename Traits>
+void BasicTriangulation<Traits>::walk_from(uint32_t id) {
+  m_last = solid(id);
+}
+
+template <typename Traits>
+typename BasicTriangulation<Traits>::TriNode* BasicTriangulation<Traits>::solid(uint32_t id) const {
+  TriNode* node = m_incident[id];
+  if (!node->is_ghost()) return node;
+  int g = 0;
+  while (node->m_ids[g] != infinite_vertex) ++g;
+  return node->m_neighbors[(g + 1) % 3];
+}
+
+template <typename Traits>
+typename BasicTriangulation<Traits>::TriNode* BasicTriangulation<Traits>::start_near(const Point& pt) const {
+  if (m_grid.empty()) return m_last;
+  uint32_t id = m_grid[m_grid_shape.cell(pt.x, pt.y)];
+  if (id == no_vertex || !m_incident[id]) return m_last;
+  return solid(id);
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::build_grid(GridShape& shape, std::vector<uint32_t>& cells) const {
+  shape = GridShape();
+  cells.clear();
+  double min_x = std::numeric_limits<double>::infinity();
+  double min_y = min_x;
+  double max_x = -min_x;
+  double max_y = -min_x;
+  size_t live = 0;
+  for (size_t id = 0; id < m_points.size(); ++id) {
+    if (!m_incident[id]) continue;
+    min_x = std::min(min_x, static_cast<double>(m_points[id].x));
+    min_y = std::min(min_y, static_cast<double>(m_points[id].y));
+    max_x = std::max(max_x, static_cast<double>(m_points[id].x));
+    max_y = std::max(max_y, static_cast<double>(m_points[id].y));
+    ++live;
+  }
+  double width = max_x - min_x;
+  double height = max_y - min_y;
+  double extent = std::max(width, height);
+  if (live < 64 || !(extent > 0)) return;
+
+  // Cells of about two vertices each over the bounding box, kept at least
+  // extent / live wide so a flat box still gets a few rows.
+  double thinnest = extent / live;
+  double cell = std::sqrt(std::max(width, thinnest) * std::max(height, thinnest) / (live / 2.0));
+  shape.m_scale = 1 / cell;
+  shape.m_columns = static_cast<uint32_t>(width * shape.m_scale) + 1;
+  shape.m_rows = static_cast<uint32_t>(height * shape.m_scale) + 1;
+  shape.m_min_x = min_x;
+  shape.m_min_y = min_y;
+  cells.assign(static_cast<size_t>(shape.m_columns) * shape.m_rows, no_vertex);
+  for (size_t id = 0; id < m_points.size(); ++id) {
+    if (m_incident[id]) cells[shape.cell(m_points[id].x, m_points[id].y)] = static_cast<uint32_t>(id);
+  }
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::fill_hole() {
+  m_fan.clear();
+  size_t k = m_link.size();
+  size_t g = std::find(m_link.begin(), m_link.end(), infinite_vertex) - m_link.begin();
+  if (g < k) {
+    // The link runs between the two hull neighbors of the removed point,
+    // sorted by angle around it. Scanning it like Graham's hull turns every
+    // point that would dent the hull into a triangle, and what is left gets
+    // ghosts.
+    std::vector<uint32_t> chain;
+    for (size_t i = 1; i < k; ++i) {
+      uint32_t w = m_link[(g + i) % k];
+      while (chain.size() >= 2) {
+        uint32_t a = chain[chain.size() - 2];
+        uint32_t b = chain.back();
+        if (orient(m_points[a], m_points[b], m_points[w]) <= 0) break;
+        m_fan.push_back(make_leaf(a, b, w));
+        chain.pop_back();
+      }
+      chain.push_back(w);
+    }
+    for (size_t i = 0; i + 1 < chain.size(); ++i) {
+      m_fan.push_back(make_leaf(chain[i], chain[i + 1], infinite_vertex));
+    }
+  }
+  else {
+    // The link is star shaped around the removed point, so it always has
+    // an ear. Prefer those whose circumcircle holds no other link vertex,
+    // they are Delaunay and leave restore nothing to do.
+    std::vector<uint32_t> poly(m_link);
+    while (poly.size() > 3) {
+      size_t n = poly.size();
+      size_t ear = n;
+      for (size_t i = 0; i < n; ++i) {
+        const Point& a = m_points[poly[(i + n - 1) % n]];
+        const Point& b = m_points[poly[i]];
+        const Point& c = m_points[poly[(i + 1) % n]];
+        if (orient(a, b, c) <= 0) continue;
+
+        bool inside = false, empty = true;
+        for (size_t j = 2; j + 1 < n && !inside; ++j) {
+          const Point& q = m_points[poly[(i + j) % n]];
+          inside = orient(a, b, q) >= 0 && orient(b, c, q) >= 0 && orient(c, a, q) >= 0;
+          empty = empty && incircle(a, b, c, q) <= 0;
+        }
+        if (inside) continue;
+        if (ear == n) ear = i;
+        if (empty) {
+          ear = i;
+          break;
+        }
+      }
+
+      m_fan.push_back(make_leaf(poly[(ear + n - 1) % n], poly[ear], poly[(ear + 1) % n]));
+      poly.erase(poly.begin() + ear);
+    }
+    m_fan.push_back(make_leaf(poly[0], poly[1], poly[2]));
+  }
+
+  // Link edges face the triangles outside the hole, the rest pair up.
+  for (TriNode* f : m_fan) {
+    for (int e = 0; e < 3; ++e) {
+      uint32_t a = f->m_ids[e];
+      uint32_t b = f->m_ids[(e + 1) % 3];
+      for (size_t i = 0; i < k && !f->m_neighbors[e]; ++i) {
+        if (m_link[i] != a || m_link[(i + 1) % k] != b) continue;
+        f->m_neighbors[e] = m_outer[i];
+        relink(m_outer[i], m_cavity[i], f);
+      }
+      for (TriNode* h : m_fan) {
+        if (f->m_neighbors[e]) break;
+        for (int j = 0; j < 3; ++j) {
+          if (h->m_ids[j] == b && h->m_ids[(j + 1) % 3] == a) f->m_neighbors[e] = h;
+        }
+      }
     }
   }
 }
 
-void Triangulation::get_triangulation(TriNode*& node,
-    std::vector<float>& tris, 
-    std::set<TriNode*>& visited) {
-  if (!node) return;
-  bool recursed = false;
+template <typename Traits>
+void BasicTriangulation<Traits>::restore() {
+  // Lawson's flips, each one exposing the four edges around the new pair.
+  // Edges of triangles flipped away meanwhile are skipped.
+  m_cavity.clear();
+  while (!m_edges.empty()) {
+    TriNode* node = m_edges.back().first;
+    int edge = m_edges.back().second;
+    m_edges.pop_back();
+    if (node->m_children[0]) continue;
+
+    TriNode* n = node->m_neighbors[edge];
+    int j = edge_of(n, node);
+    if (n->m_ids[(j + 2) % 3] == infinite_vertex) continue;
+    if (is_constrained(node->m_ids[edge], node->m_ids[(edge + 1) % 3])) continue;
+    if (!conflicts(node, n->m_pts[(j + 2) % 3])) continue;
+
+    TriNode* t1;
+    TriNode* t2;
+    flip(node, edge, t1, t2);
+    m_cavity.push_back(node);
+    m_cavity.push_back(n);
+    m_edges.push_back(std::make_pair(t1, 0));
+    m_edges.push_back(std::make_pair(t1, 1));
+    m_edges.push_back(std::make_pair(t2, 1));
+    m_edges.push_back(std::make_pair(t2, 2));
+  }
+
+  if (m_history) return;
+  for (TriNode* t : m_cavity) m_nodes.destroy(t);
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::start(uint32_t a, uint32_t b, uint32_t c) {
+  // Walking relies on every triangle being counter clockwise.
+  if (orient(m_points[a], m_points[b], m_points[c]) < 0) std::swap(b, c);
+  TriNode* node = make_leaf(a, b, c);
+
+  // The ghost across edge i runs the other way along it. Ghosts meet each
+  // other on the edges out to infinity.
+  TriNode* ghosts[3];
   for (int i = 0; i < 3; ++i) {
-    if (node->m_children[i]) {
-      get_triangulation(node->m_children[i], tris, visited);
-      recursed = true;
+    ghosts[i] = make_leaf(node->m_ids[(i + 1) % 3], node->m_ids[i], infinite_vertex);
+  }
+  for (int i = 0; i < 3; ++i) {
+    node->m_neighbors[i] = ghosts[i];
+    ghosts[i]->m_neighbors[0] = node;
+    ghosts[i]->m_neighbors[1] = ghosts[(i + 2) % 3];
+    ghosts[i]->m_neighbors[2] = ghosts[(i + 1) % 3];
+  }
+
+  if (m_history) m_roots.push_back(node);
+  m_last = node;
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::link(TriNode* node, uint32_t id) {
+  if (m_kernel == Kernel::cavity) {
+    m_last = insert_cavity(node, id);
+    return;
+  }
+
+  // A ghost is only located for points strictly beyond its hull edge.
+  const Point& pt = m_points[id];
+  int edge = -1;
+  for (int i = 0; i < 3 && !node->is_ghost(); ++i) {
+    if (orient(node->m_pts[i], node->m_pts[(i + 1) % 3], pt) == 0) edge = i;
+  }
+
+  TriNode* c[4];
+  int count = 3;
+  if (edge >= 0) {
+    count = split_edge(node, edge, id, c);
+  }
+  else {
+    // Create three new triangles with the given point.
+    for (int i = 0; i < 3; ++i) {
+      c[i] = make_leaf(id, node->m_ids[i], node->m_ids[(i + 1) % 3]);
+    }
+    remove_leaf(node);
+
+    for (int i = 0; i < 3; ++i) {
+      c[i]->m_neighbors[0] = c[(i + 2) % 3];
+      c[i]->m_neighbors[1] = node->m_neighbors[i];
+      c[i]->m_neighbors[2] = c[(i + 1) % 3];
+      relink(node->m_neighbors[i], node, c[i]);
+      node->m_children[i] = c[i];
+    }
+
+    // No root covers the part of a ghost that is now inside the hull.
+    if (m_history && node->is_ghost()) {
+      for (int i = 0; i < 3; ++i) {
+        if (!c[i]->is_ghost()) m_roots.push_back(c[i]);
+      }
+    }
+    if (!m_history) m_nodes.destroy(node);
+  }
+
+  // Legalize the edges opposite the new point. Flips never touch the edges
+  // around pt, so each c[i] is still a leaf when its turn comes.
+  for (int i = 0; i < count; ++i) legalize(c[i], 1);
+
+  m_last = solid(id);
+}
+
+template <typename Traits>
+int BasicTriangulation<Traits>::split_edge(TriNode* node, int edge, uint32_t id, TriNode** c) {
+  TriNode* n = node->m_neighbors[edge];
+  // node is (a, b, e) rotated so the new point lies on a-b, n is (b, a, d).
+  uint32_t a = node->m_ids[edge];
+  uint32_t b = node->m_ids[(edge + 1) % 3];
+  uint32_t e = node->m_ids[(edge + 2) % 3];
+
+  c[0] = make_leaf(id, b, e);
+  c[1] = make_leaf(id, e, a);
+
+  c[0]->m_neighbors[1] = node->m_neighbors[(edge + 1) % 3];
+  c[0]->m_neighbors[2] = c[1];
+  c[1]->m_neighbors[0] = c[0];
+  c[1]->m_neighbors[1] = node->m_neighbors[(edge + 2) % 3];
+
+  relink(c[0]->m_neighbors[1], node, c[0]);
+  relink(c[1]->m_neighbors[1], node, c[1]);
+
+  node->m_children[0] = c[0];
+  node->m_children[1] = c[1];
+  remove_leaf(node);
+
+  int j = edge_of(n, node);
+  uint32_t d = n->m_ids[(j + 2) % 3];
+
+  c[2] = make_leaf(id, a, d);
+  c[3] = make_leaf(id, d, b);
+
+  c[0]->m_neighbors[0] = c[3];
+  c[1]->m_neighbors[2] = c[2];
+  c[2]->m_neighbors[0] = c[1];
+  c[2]->m_neighbors[1] = n->m_neighbors[(j + 1) % 3];
+  c[2]->m_neighbors[2] = c[3];
+  c[3]->m_neighbors[0] = c[2];
+  c[3]->m_neighbors[1] = n->m_neighbors[(j + 2) % 3];
+  c[3]->m_neighbors[2] = c[0];
+
+  relink(c[2]->m_neighbors[1], n, c[2]);
+  relink(c[3]->m_neighbors[1], n, c[3]);
+
+  n->m_children[0] = c[2];
+  n->m_children[1] = c[3];
+  remove_leaf(n);
+
+  if (is_constrained(a, b)) {
+    m_fixed.erase(edge_key(a, b));
+    m_fixed.insert(edge_key(a, id));
+    m_fixed.insert(edge_key(id, b));
+  }
+  if (!m_history) {
+    m_nodes.destroy(node);
+    m_nodes.destroy(n);
+  }
+  return 4;
+}
+
+template <typename Traits>
+typename BasicTriangulation<Traits>::TriNode* BasicTriangulation<Traits>::insert_cavity(TriNode* node, uint32_t id) {
+  const Point pt = m_points[id];
+  // Grow the cavity from node over every neighbor whose circumcircle holds
+  // pt. With exact predicates it stays connected and star shaped around pt,
+  // and the constraints keep everything in it visible from pt.
+  m_cavity.clear();
+  m_cavity.push_back(node);
+  for (size_t i = 0; i < m_cavity.size(); ++i) {
+    TriNode* t = m_cavity[i];
+    for (int e = 0; e < 3; ++e) {
+      TriNode* n = t->m_neighbors[e];
+      if (in(m_cavity, n)) continue;
+      if (!conflicts(n, pt)) continue;
+
+      // Constraints wall the cavity in, except one pt is on, which it
+      // splits in two.
+      uint32_t u = t->m_ids[e];
+      uint32_t v = t->m_ids[(e + 1) % 3];
+      if (is_constrained(u, v)) {
+        if (orient(t->m_pts[e], t->m_pts[(e + 1) % 3], pt) != 0) continue;
+        m_fixed.erase(edge_key(u, v));
+        m_fixed.insert(edge_key(u, id));
+        m_fixed.insert(edge_key(id, v));
+      }
+      m_cavity.push_back(n);
+    }
+  }
+
+  // Fan the cavity's boundary edges out from pt.
+  m_fan.clear();
+  for (TriNode* t : m_cavity) {
+    for (int e = 0; e < 3; ++e) {
+      TriNode* n = t->m_neighbors[e];
+      if (in(m_cavity, n)) continue;
+      TriNode* f = make_leaf(id, t->m_ids[e], t->m_ids[(e + 1) % 3]);
+      f->m_neighbors[1] = n;
+      relink(n, t, f);
+      m_fan.push_back(f);
+    }
+  }
+
+  // Consecutive fan triangles share the edge from pt to the vertex between
+  // them.
+  for (TriNode* f : m_fan) {
+    for (TriNode* g : m_fan) {
+      if (f->m_ids[2] == g->m_ids[1]) {
+        f->m_neighbors[2] = g;
+        g->m_neighbors[0] = f;
+      }
     }
   }
 
-  // If this is a leaf node and it hasn't been added to the tris list.
-  if (!recursed && visited.find(node) == visited.end()) {
-  //if (!recursed && visited.find(node) == visited.end()
-  //    && !vert_in(b1, node->m_pts) && !vert_in(b2, node->m_pts)) {
-    visited.insert(node);
+  for (TriNode* t : m_cavity) {
+    remove_leaf(t);
+    m_nodes.destroy(t);
+  }
+
+  // At most two of the fan are ghosts, those on the hull edges out of pt.
+  for (TriNode* f : m_fan) {
+    if (!f->is_ghost()) return f;
+  }
+  return m_fan.front();
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::flip(TriNode* node, int edge, TriNode*& t1, TriNode*& t2) {
+  TriNode* n = node->m_neighbors[edge];
+  int j = edge_of(n, node);
+  // node is (c, a, b) rotated so the flipped edge is a-b, n is (b, a, d).
+  uint32_t a = node->m_ids[edge];
+  uint32_t b = node->m_ids[(edge + 1) % 3];
+  uint32_t c = node->m_ids[(edge + 2) % 3];
+  uint32_t d = n->m_ids[(j + 2) % 3];
+
+  t1 = make_leaf(c, a, d);
+  t2 = make_leaf(c, d, b);
+
+  t1->m_neighbors[0] = node->m_neighbors[(edge + 2) % 3];
+  t1->m_neighbors[1] = n->m_neighbors[(j + 1) % 3];
+  t1->m_neighbors[2] = t2;
+
+  t2->m_neighbors[0] = t1;
+  t2->m_neighbors[1] = n->m_neighbors[(j + 2) % 3];
+  t2->m_neighbors[2] = node->m_neighbors[(edge + 1) % 3];
+
+  relink(t1->m_neighbors[0], node, t1);
+  relink(t1->m_neighbors[1], n, t1);
+  relink(t2->m_neighbors[1], n, t2);
+  relink(t2->m_neighbors[2], node, t2);
+
+  node->m_children[0] = n->m_children[0] = t1;
+  node->m_children[1] = n->m_children[1] = t2;
+  remove_leaf(node);
+  remove_leaf(n);
+
+  // Flipping two ghosts moves the hull out over a new triangle.
+  if (m_history && node->is_ghost() && n->is_ghost()) {
+    m_roots.push_back(t1->is_ghost() ? t2 : t1);
+  }
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::legalize(TriNode* node, int edge) {
+  TriNode* n = node->m_neighbors[edge];
+  int j = edge_of(n, node);
+  // Hull edges stay, no circle holds the vertex at infinity.
+  if (n->m_ids[(j + 2) % 3] == infinite_vertex) return;
+  if (is_constrained(node->m_ids[edge], node->m_ids[(edge + 1) % 3])) return;
+  if (!conflicts(node, n->m_pts[(j + 2) % 3])) return;
+
+  TriNode* t1;
+  TriNode* t2;
+  flip(node, edge, t1, t2);
+  if (!m_history) {
+    m_nodes.destroy(node);
+    m_nodes.destroy(n);
+  }
+  legalize(t1, 1);
+  legalize(t2, 1);
+}
+
+template <typename Traits>
+std::vector<typename Traits::Scalar> BasicTriangulation<Traits>::get_tris() const {
+  std::vector<Scalar> tris(6 * m_leaves.size());
+  get_tris(tris.data());
+  return tris;
+}
+
+template <typename Traits>
+size_t BasicTriangulation<Traits>::get_tris(Scalar* tris) const {
+  Scalar* out = tris;
+  for (const TriNode* node : m_leaves) {
     for (int i = 0; i < 3; ++i) {
-      tris.push_back(node->m_pts[i].x);
-      tris.push_back(node->m_pts[i].y);
+      *out++ = node->m_pts[i].x;
+      *out++ = node->m_pts[i].y;
     }
   }
+  return out - tris;
 }
 
-void Triangulation::recursive_delete(TriNode*& node) {
-  if (!node) return;
+template <typename Traits>
+size_t BasicTriangulation<Traits>::triangle_count() const {
+  return m_leaves.size();
+}
 
-  for (int i = 0; i < 3; ++i) {
-    if (node->m_children[i]) recursive_delete(node->m_children[i]);
+template <typename Traits>
+const std::vector<typename BasicTriangulation<Traits>::Point>& BasicTriangulation<Traits>::get_vertices() const {
+  return m_points;
+}
+
+template <typename Traits>
+std::vector<uint32_t> BasicTriangulation<Traits>::get_indices() const {
+  std::vector<uint32_t> indices(3 * m_leaves.size());
+  get_indices(indices.data());
+  return indices;
+}
+
+template <typename Traits>
+size_t BasicTriangulation<Traits>::get_indices(uint32_t* indices) const {
+  uint32_t* out = indices;
+  for (const TriNode* node : m_leaves) {
+    *out++ = node->m_ids[0];
+    *out++ = node->m_ids[1];
+    *out++ = node->m_ids[2];
+  }
+  return out - indices;
+}
+
+template <typename Traits>
+size_t BasicTriangulation<Traits>::bytes() const {
+  return m_nodes.bytes()
+    + m_roots.capacity() * sizeof(TriNode*)
+    + m_leaves.capacity() * sizeof(TriNode*)
+    + m_points.capacity() * sizeof(Point)
+    + m_incident.capacity() * sizeof(TriNode*)
+    + m_grid.capacity() * sizeof(uint32_t)
+    + m_fixed.size() * sizeof(uint64_t)
+    + m_fixed.bucket_count() * sizeof(void*);
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::find(const Point& pt, std::vector<TriNode*>& nodes) {
+  if (m_locate == Locate::walk) {
+    if (!m_last) return;
+    TriNode* node = walk(pt, start_near(pt), m_seed);
+    if (node->is_ghost()) return;
+    m_last = node;
+    nodes.push_back(node);
+    return;
   }
 
-  delete node;
-  node = nullptr;
+  std::set<TriNode*> added;
+  find(pt, m_roots.data(), m_roots.size(), nodes, added);
 }
 
-void legalize_edge(const Point& p1, const Point& p2, const Point& p3, Triangulation& tria) {
-  TriNode* split = tria.split(p2, p3);
-  if (!split) return;
-  Point* pts1 = split->m_children[0]->m_pts;
-  Point* pts2 = split->m_children[1]->m_pts;
-  // Find the new point not belonging to p1, p2, or p3 and legalize edges to it.
-  Point p;
-  Point bounds[3] = {p1, p2, p3};
+template <typename Traits>
+size_t BasicTriangulation<Traits>::validate() const {
+  size_t failed = 0;
+  BasicTriangles4<Scalar> tris;
+  for (size_t i = 0; i < m_leaves.size(); i += 4) {
+    unsigned n = static_cast<unsigned>(std::min<size_t>(4, m_leaves.size() - i));
+    for (unsigned k = 0; k < 4; ++k) set_lane(tris, k, m_leaves[i + std::min(k, n - 1)]->m_pts);
+    for (unsigned ccw = ccw4(tris, n); ccw != (1u << n) - 1; ccw |= ccw + 1) ++failed;
+  }
+
+  // Edges between two leaves are checked once, from the one in the lower
+  // slot, batched four at a time.
+  Scalar x[4], y[4];
+  unsigned n = 0;
+  for (size_t slot = 0; slot < m_leaves.size(); ++slot) {
+    const TriNode* node = m_leaves[slot];
+    if (node->m_slot != slot || node->is_ghost()) ++failed;
+    for (int e = 0; e < 3; ++e) {
+      const TriNode* neighbor = node->m_neighbors[e];
+      if (!neighbor) {
+        ++failed;
+        continue;
+      }
+      int j = edge_of(neighbor, node);
+      if (neighbor->m_neighbors[j] != node
+          || neighbor->m_ids[j] != node->m_ids[(e + 1) % 3]
+          || neighbor->m_ids[(j + 1) % 3] != node->m_ids[e]) {
+        ++failed;
+        continue;
+      }
+      if (neighbor->is_ghost() || neighbor->m_slot < slot) continue;
+      if (m_fixed.count(edge_key(node->m_ids[e], node->m_ids[(e + 1) % 3]))) continue;
+
+      set_lane(tris, n, node->m_pts);
+      x[n] = neighbor->m_pts[(j + 2) % 3].x;
+      y[n] = neighbor->m_pts[(j + 2) % 3].y;
+      ++n;
+      if (n == 4) {
+        for (unsigned in = in_circle4(tris, x, y, n); in; in &= in - 1) ++failed;
+        n = 0;
+      }
+    }
+  }
+  if (n) {
+    for (unsigned in = in_circle4(tris, x, y, n); in; in &= in - 1) ++failed;
+  }
+  return failed;
+}
+
+template <typename Traits>
+uint32_t BasicTriangulation<Traits>::nearest(const Point& pt) {
+  Search search;
+  start_search(pt, search);
+  uint32_t id = closest(pt, search);
+  m_last = search.m_start;
+  m_seed = search.m_seed;
+  return id;
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::k_nearest(const Point& pt, size_t k, std::vector<uint32_t>& ids) {
+  Search search;
+  start_search(pt, search);
+  ids.resize(k);
+  ids.resize(k_closest(pt, k, search, ids.data()));
+  m_last = search.m_start;
+  m_seed = search.m_seed;
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::find_batch(const Scalar* xy, size_t count, uint32_t* triangles, unsigned threads) const {
+  if (!count) return;
+  if (m_leaves.empty()) {
+    std::fill(triangles, triangles + count, no_triangle);
+    return;
+  }
+
+  threads = query_threads(count, threads);
+  std::vector<uint32_t> order;
+  curve_order(xy, count, 2 * sizeof(Scalar), Curve::hilbert, threads, order);
+  parallel_for(count, threads, [&](size_t begin, size_t end, unsigned thread) {
+    TriNode* node = start_near(Point(xy[2 * order[begin]], xy[2 * order[begin] + 1]));
+    uint32_t seed = (m_seed + 0x9e3779b9u * thread) | 1;
+    for (size_t i = begin; i < end; ++i) {
+      uint32_t q = order[i];
+      TriNode* found = walk(Point(xy[2 * q], xy[2 * q + 1]), node, seed);
+      if (found->is_ghost()) {
+        triangles[q] = no_triangle;
+        continue;
+      }
+      node = found;
+      triangles[q] = found->m_slot;
+
+      // Queries sorted along the curve often land in the same triangle,
+      // test the next ones against it four at a time before walking again.
+      BasicTriangles4<Scalar> tris;
+      for (unsigned k = 0; k < 4; ++k) set_lane(tris, k, node->m_pts);
+      while (i + 1 < end) {
+        unsigned n = static_cast<unsigned>(std::min<size_t>(4, end - i - 1));
+        Scalar x[4], y[4];
+        for (unsigned k = 0; k < 4; ++k) {
+          uint32_t r = order[i + 1 + std::min(k, n - 1)];
+          x[k] = xy[2 * r];
+          y[k] = xy[2 * r + 1];
+        }
+        unsigned in = in_triangle4(tris, x, y, n);
+        unsigned k = 0;
+        while (k < n && ((in >> k) & 1)) triangles[order[i + 1 + k++]] = node->m_slot;
+        i += k;
+        if (k < n) break;
+      }
+    }
+  });
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::nearest(const Point* pts, size_t count, uint32_t* ids, unsigned threads) const {
+  if (!count) return;
+  threads = query_threads(count, threads);
+  std::vector<uint32_t> order;
+  curve_order(&pts[0].x, count, sizeof(Point), Curve::hilbert, threads, order);
+  parallel_for(count, threads, [&](size_t begin, size_t end, unsigned thread) {
+    Search search;
+    search.m_start = start_near(pts[order[begin]]);
+    search.m_seed = (m_seed + 0x9e3779b9u * thread) | 1;
+    for (size_t i = begin; i < end; ++i) ids[order[i]] = closest(pts[order[i]], search);
+  });
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::k_nearest(const Point* pts,
+    size_t count,
+    size_t k,
+    uint32_t* ids,
+    unsigned threads) const {
+  if (!count) return;
+  threads = query_threads(count, threads);
+  std::vector<uint32_t> order;
+  curve_order(&pts[0].x, count, sizeof(Point), Curve::hilbert, threads, order);
+  parallel_for(count, threads, [&](size_t begin, size_t end, unsigned thread) {
+    Search search;
+    search.m_start = start_near(pts[order[begin]]);
+    search.m_seed = (m_seed + 0x9e3779b9u * thread) | 1;
+    for (size_t i = begin; i < end; ++i) {
+      k_closest(pts[order[i]], k, search, ids + k * order[i]);
+    }
+  });
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::start_search(const Point& pt, Search& search) {
+  std::vector<TriNode*> nodes;
+  find(pt, nodes);
+  search.m_start = nodes.empty() ? m_last : nodes.front();
+  search.m_seed = m_seed;
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::adjacent(uint32_t id, std::vector<uint32_t>& out) const {
+  out.clear();
+  const TriNode* first = m_incident[id];
+  const TriNode* t = first;
+  do {
+    int i = 0;
+    while (t->m_ids[i] != id) ++i;
+    out.push_back(t->m_ids[(i + 1) % 3]);
+    t = t->m_neighbors[(i + 2) % 3];
+  } while (t != first);
+}
+
+template <typename Traits>
+uint32_t BasicTriangulation<Traits>::closest(const Point& pt, Search& search) const {
+  uint32_t best = no_vertex;
+  double d = DBL_MAX;
+  if (m_leaves.empty()) {
+    for (uint32_t id : m_pending) {
+      double e = distance2(pt, m_points[id]);
+      if (e < d) {
+        d = e;
+        best = id;
+      }
+    }
+    return best;
+  }
+
+  TriNode* node = walk(pt, search.m_start, search.m_seed);
+  if (!node->is_ghost()) search.m_start = node;
   for (int i = 0; i < 3; ++i) {
-    if (!vert_in(pts1[i], bounds)) {
-      p = pts1[i];
-      break;
+    uint32_t id = node->m_ids[i];
+    if (id == infinite_vertex) continue;
+    double e = distance2(pt, m_points[id]);
+    if (e < d) {
+      d = e;
+      best = id;
     }
-    if (!vert_in(pts2[i], bounds)) {
-      p = pts2[i];
-      break;
+  }
+
+  // A vertex that isn't the closest always has a neighbor closer than it.
+  for (bool closer = true; closer;) {
+    closer = false;
+    adjacent(best, search.m_around);
+    for (uint32_t id : search.m_around) {
+      if (id == infinite_vertex) continue;
+      double e = distance2(pt, m_points[id]);
+      if (e < d) {
+        d = e;
+        best = id;
+        closer = true;
+      }
     }
   }
-  legalize_edge(p1, p2, p, tria);
-  legalize_edge(p1, p3, p, tria);
+  return best;
 }
 
+template <typename Traits>
+size_t BasicTriangulation<Traits>::k_closest(const Point& pt, size_t k, Search& search, uint32_t* ids) const {
+  std::vector<std::pair<double, uint32_t>>& heap = search.m_heap;
+  std::greater<std::pair<double, uint32_t>> farther;
+  heap.clear();
+  size_t found = 0;
+  if (m_leaves.empty()) {
+    for (uint32_t id : m_pending) heap.push_back(std::make_pair(distance2(pt, m_points[id]), id));
+    found = std::min(k, heap.size());
+    std::partial_sort(heap.begin(), heap.begin() + found, heap.end());
+    for (size_t i = 0; i < found; ++i) ids[i] = heap[i].second;
+  }
+  else if (k) {
+    // Taking the closest vertex not taken yet each time, it is always next
+    // to one taken before.
+    uint32_t first = closest(pt, search);
+    search.m_seen.clear();
+    search.m_seen.insert(first);
+    heap.push_back(std::make_pair(distance2(pt, m_points[first]), first));
+    while (found < k && !heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), farther);
+      uint32_t id = heap.back().second;
+      heap.pop_back();
+      ids[found++] = id;
+      adjacent(id, search.m_around);
+      for (uint32_t v : search.m_around) {
+        if (v == infinite_vertex || !search.m_seen.insert(v).second) continue;
+        heap.push_back(std::make_pair(distance2(pt, m_points[v]), v));
+        std::push_heap(heap.begin(), heap.end(), farther);
+      }
+    }
+  }
+  for (size_t i = found; i < k; ++i) ids[i] = no_vertex;
+  return found;
 }
 
-void delaunay::circle(const Point& a,
-    const Point& b,
-    const Point& c, 
-    Point& center,
-    float& radius) {
-  float ma = (b.y - a.y) / (b.x - a.x);
-  float mb = (c.y - b.y) / (c.x - b.x);
-  float x = (ma * mb * (a.y - c.y) + mb * (a.x + b.x) - ma * (b.x + c.x)) / (2 * (mb - ma));
-  float y = (-1.0f / ma) * (x - (a.x + b.x) / 2.0f) + ((a.y + b.y) / 2.0f);
+template <typename Traits>
+void BasicTriangulation<Traits>::reserve(size_t count) {
+  m_points.reserve(m_points.size() + count);
+  m_incident.reserve(m_incident.size() + count);
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::set_locate(Locate locate) {
+  m_locate = m_history ? locate : Locate::walk;
+}
+
+template <typename Traits>
+Locate BasicTriangulation<Traits>::get_locate() const {
+  return m_locate;
+}
 
-  center = Point(x, y);
-  Point d = sub(a, c);
+template <typename Traits>
+void BasicTriangulation<Traits>::set_kernel(Kernel kernel) {
+  m_kernel = kernel;
+  if (kernel == Kernel::cavity) drop_history();
+}
+
+template <typename Traits>
+Kernel BasicTriangulation<Traits>::get_kernel() const {
+  return m_kernel;
+}
 
-  Point r_diff = sub(a, center);
-  float dot_diff = dot(r_diff, r_diff);
+template <typename Traits>
+void BasicTriangulation<Traits>::drop_history() {
+  if (!m_history) return;
 
-  radius = sqrtf(dot_diff);
+  // Freed triangles would leave holes in the history, so stop keeping it.
+  // From here on triangles are freed as they die, the ones the history
+  // held stay allocated until compact or the triangulation goes away.
+  while (m_last && m_last->m_children[0]) m_last = m_last->m_children[0];
+  m_history = false;
+  m_roots.clear();
+  m_locate = Locate::walk;
 }
 
-delaunay::Triangulation* delaunay::triangulate(const std::vector<float>& points) {
-  // Find max point.
-  Point max(-FLT_MAX, -FLT_MAX);
-  for (size_t i = 0; i < points.size(); i += 2) {
-    if (points[i + 1] > max.y) max = Point(points[i], points[i + 1]);
+template <typename Traits>
+void BasicTriangulation<Traits>::compact(std::vector<uint32_t>* ids, unsigned threads) {
+  drop_history();
+
+  if (ids) {
+    // Removed vertices are in no triangle and not pending.
+    std::vector<bool> live(m_points.size());
+    for (size_t id = 0; id < m_points.size(); ++id) live[id] = m_incident[id] != nullptr;
+    for (uint32_t id : m_pending) live[id] = true;
+    std::vector<uint32_t> kept;
+    std::vector<Scalar> xy;
+    for (size_t id = 0; id < m_points.size(); ++id) {
+      if (!live[id]) continue;
+      kept.push_back(static_cast<uint32_t>(id));
+      xy.push_back(m_points[id].x);
+      xy.push_back(m_points[id].y);
+    }
+    std::vector<uint32_t> order;
+    curve_order(xy.data(), kept.size(), 2 * sizeof(Scalar), Curve::hilbert, threads, order);
+
+    ids->assign(m_points.size(), no_vertex);
+    std::vector<Point> points(kept.size());
+    std::vector<TriNode*> incident(kept.size());
+    for (size_t i = 0; i < kept.size(); ++i) {
+      uint32_t id = kept[order[i]];
+      (*ids)[id] = static_cast<uint32_t>(i);
+      points[i] = m_points[id];
+      incident[i] = m_incident[id];
+    }
+    m_points.swap(points);
+    m_incident.swap(incident);
+    for (uint32_t& id : m_pending) id = (*ids)[id];
+    std::unordered_set<uint64_t> fixed;
+    for (uint64_t key : m_fixed) {
+      fixed.insert(edge_key((*ids)[key >> 32], (*ids)[key & 0xffffffffu]));
+    }
+    m_fixed.swap(fixed);
+    for (TriNode* leaf : m_leaves) {
+      for (int i = 0; i < 3; ++i) leaf->m_ids[i] = (*ids)[leaf->m_ids[i]];
+    }
+  }
+
+  // The leaves along the curve through their centroids, then the ghosts
+  // in the order of the hull edges they are found across. m_slot holds
+  // each node's new index until the copies are linked up.
+  std::vector<Scalar> centroids(2 * m_leaves.size());
+  for (size_t i = 0; i < m_leaves.size(); ++i) {
+    const Point* p = m_leaves[i]->m_pts;
+    centroids[2 * i] = static_cast<Scalar>((static_cast<double>(p[0].x) + p[1].x + p[2].x) / 3);
+    centroids[2 * i + 1] = static_cast<Scalar>((static_cast<double>(p[0].y) + p[1].y + p[2].y) / 3);
+  }
+  std::vector<uint32_t> order;
+  curve_order(centroids.data(), m_leaves.size(), 2 * sizeof(Scalar), Curve::hilbert, threads, order);
+  std::vector<TriNode*> nodes;
+  nodes.reserve(2 * m_leaves.size());
+  for (uint32_t i : order) nodes.push_back(m_leaves[i]);
+  for (size_t i = 0; i < m_leaves.size(); ++i) nodes[i]->m_slot = static_cast<uint32_t>(i);
+  for (size_t i = 0; i < m_leaves.size(); ++i) {
+    for (int j = 0; j < 3; ++j) {
+      TriNode* ghost = nodes[i]->m_neighbors[j];
+      if (!ghost->is_ghost()) continue;
+      if (ids) {
+        for (int k = 0; k < 3; ++k) {
+          if (ghost->m_ids[k] != infinite_vertex) ghost->m_ids[k] = (*ids)[ghost->m_ids[k]];
+        }
+      }
+      ghost->m_slot = static_cast<uint32_t>(nodes.size());
+      nodes.push_back(ghost);
+    }
   }
 
-  std::vector<Point> ps((points.size() / 2) - 1);
-  size_t j = 0;
-  for (size_t i = 0; i < points.size(); i += 2) {
-    Point pt(points[i], points[i + 1]);
-    if (!equal(pt, max)) ps[j++] = pt;
+  std::vector<TriNode> copies;
+  std::vector<uint32_t> across(3 * nodes.size());
+  copies.reserve(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    copies.push_back(*nodes[i]);
+    for (int j = 0; j < 3; ++j) across[3 * i + j] = nodes[i]->m_neighbors[j]->m_slot;
   }
 
-  Point bounds[3] = { b1, b2, max };
-  Triangulation* tria = new Triangulation(b1, b2, max, ps);
+  // Releases the history along with every replaced triangle, the fresh
+  // nodes come out of the allocator back to back.
+  m_nodes.clear();
+  for (size_t i = 0; i < copies.size(); ++i) {
+    const TriNode& copy = copies[i];
+    nodes[i] = m_nodes.create(copy.m_pts[0], copy.m_pts[1], copy.m_pts[2]);
+  }
+  std::fill(m_incident.begin(), m_incident.end(), nullptr);
+  for (size_t i = 0; i < copies.size(); ++i) {
+    TriNode* node = nodes[i];
+    for (int j = 0; j < 3; ++j) {
+      node->m_ids[j] = copies[i].m_ids[j];
+      node->m_neighbors[j] = nodes[across[3 * i + j]];
+      if (node->m_ids[j] != infinite_vertex && !m_incident[node->m_ids[j]]) m_incident[node->m_ids[j]] = node;
+    }
+  }
+  std::vector<TriNode*>(nodes.begin(), nodes.begin() + order.size()).swap(m_leaves);
+  for (size_t i = 0; i < m_leaves.size(); ++i) m_leaves[i]->m_slot = static_cast<uint32_t>(i);
+  m_last = m_leaves.empty() ? nullptr : m_leaves.front();
 
-  std::random_shuffle(ps.begin(), ps.end());
-  for (size_t i = 0; i < ps.size(); ++i) {
-    Point& pt = ps[i];
-    TriNode* inserted = tria->insert(pt);
+  m_points.shrink_to_fit();
+  m_incident.shrink_to_fit();
+  // Nothing is kept in the scratch space between calls.
+  std::vector<TriNode*>().swap(m_roots);
+  std::vector<TriNode*>().swap(m_cavity);
+  std::vector<TriNode*>().swap(m_fan);
+  std::vector<uint32_t>().swap(m_link);
+  std::vector<TriNode*>().swap(m_outer);
+  std::vector<std::pair<TriNode*, int>>().swap(m_edges);
+  std::vector<std::pair<uint32_t, uint32_t>>().swap(m_crossed);
+  std::vector<std::pair<uint32_t, uint32_t>>().swap(m_flipped);
+  build_grid(m_grid_shape, m_grid);
+}
 
-    if (!inserted) continue;
+template <typename Traits>
+typename BasicTriangulation<Traits>::TriNode* BasicTriangulation<Traits>::make_leaf(uint32_t a, uint32_t b, uint32_t c) {
+  TriNode* node = m_nodes.create(a == infinite_vertex ? infinity<Scalar>() : m_points[a],
+    b == infinite_vertex ? infinity<Scalar>() : m_points[b],
+    c == infinite_vertex ? infinity<Scalar>() : m_points[c]);
+  node->m_ids[0] = a;
+  node->m_ids[1] = b;
+  node->m_ids[2] = c;
+  for (int i = 0; i < 3; ++i) {
+    if (node->m_ids[i] != infinite_vertex) m_incident[node->m_ids[i]] = node;
+  }
+  if (node->is_ghost()) return node;
+  node->m_slot = static_cast<uint32_t>(m_leaves.size());
+  m_leaves.push_back(node);
+  return node;
+}
 
-    // Legalize each new edge.
-    Point* pts1 = inserted->m_children[0]->m_pts;
-    Point* pts2 = inserted->m_children[1]->m_pts;
-    Point* pts3 = inserted->m_children[2]->m_pts;
+template <typename Traits>
+void BasicTriangulation<Traits>::remove_leaf(TriNode* node) {
+  if (node->is_ghost()) return;
+  TriNode* last = m_leaves.back();
+  last->m_slot = node->m_slot;
+  m_leaves[node->m_slot] = last;
+  m_leaves.pop_back();
+}
 
-    if (!vert_in(pts1[1], bounds) || !vert_in(pts1[2], bounds)) {
-      legalize_edge(pt, pts1[1], pts1[2], *tria);
+template <typename Traits>
+typename BasicTriangulation<Traits>::TriNode* BasicTriangulation<Traits>::locate(const Point& pt) {
+  if (m_locate == Locate::history) {
+    std::vector<TriNode*> nodes;
+    std::set<TriNode*> added;
+    find(pt, m_roots.data(), m_roots.size(), nodes, added);
+    // Points on an edge are in two leaves, either will do, but any leaf
+    // with a vertex this close means pt is already in.
+    for (TriNode* node : nodes) {
+      if (!m_welded && vert_in(pt, node->m_pts)) return nullptr;
     }
+    if (!nodes.empty()) return nodes.front();
+  }
+
+  // Points outside the hull are under no root, the walk finds their ghost.
+  TriNode* node = walk(pt, start_near(pt), m_seed);
+  if (!node->is_ghost()) m_last = node;
+  if (!m_welded && vert_in(pt, node->m_pts)) return nullptr;
+  return node;
+}
+
+template <typename Traits>
+typename BasicTriangulation<Traits>::TriNode* BasicTriangulation<Traits>::walk(const Point& pt, TriNode* start, uint32_t& seed) const {
+  // The start may have been split or flipped since, any descendant is close.
+  TriNode* node = start;
+  while (node->m_children[0]) node = node->m_children[0];
 
-    if (!vert_in(pts2[1], bounds) || !vert_in(pts2[2], bounds)) {
-      legalize_edge(pt, pts2[1], pts2[2], *tria);
+  TriNode* previous = nullptr;
+  for (;;) {
+    // Never step back over the edge we came from, and try the other two in
+    // random order so the walk can't cycle.
+    int first = next_random(seed) % 3;
+    TriNode* next = nullptr;
+    for (int i = 0; i < 3; ++i) {
+      int e = (first + i) % 3;
+      TriNode* n = node->m_neighbors[e];
+      if (previous && n == previous) continue;
+      if (orient(node->m_pts[e], node->m_pts[(e + 1) % 3], pt) < 0) {
+        next = n;
+        break;
+      }
     }
 
-    if (!vert_in(pts3[1], bounds) || !vert_in(pts3[2], bounds)) {
-      legalize_edge(pt, pts3[1], pts3[2], *tria);
+    if (!next) return node;
+    // pt is strictly beyond a hull edge, the ghost there holds it.
+    if (next->is_ghost()) return next;
+    previous = node;
+    node = next;
+  }
+}
+
+template <typename Traits>
+void BasicTriangulation<Traits>::find(const Point& pt,
+    TriNode* const* candidates,
+    size_t count,
+    std::vector<TriNode*>& nodes,
+    std::set<TriNode*>& added) {
+  Scalar x[4] = { pt.x, pt.x, pt.x, pt.x };
+  Scalar y[4] = { pt.y, pt.y, pt.y, pt.y };
+  for (size_t i = 0; i < count; i += 4) {
+    unsigned n = static_cast<unsigned>(std::min<size_t>(4, count - i));
+    BasicTriangles4<Scalar> tris;
+    for (unsigned k = 0; k < 4; ++k) set_lane(tris, k, candidates[i + std::min(k, n - 1)]->m_pts);
+    unsigned in = in_triangle4(tris, x, y, n);
+
+    for (unsigned k = 0; k < n; ++k) {
+      TriNode* node = candidates[i + k];
+      if (!((in >> k) & 1) && (m_welded || !vert_in(pt, node->m_pts))) continue;
+      if (node->m_children[0]) {
+        int children = node->m_children[2] ? 3 : 2;
+        find(pt, node->m_children, children, nodes, added);
+      }
+      else if (added.insert(node).second) {
+        nodes.push_back(node);
+      }
     }
   }
+}
+
+template <typename T>
+void circle(const BasicPoint<T>& a,
+    const BasicPoint<T>& b,
+    const BasicPoint<T>& c,
+    BasicPoint<T>& center,
+    T& radius) {
+  double x, y;
+  if (!center_offset(a, b, c, x, y)) {
+    // Collinear, the circle degenerates into a line.
+    center = a;
+    radius = INFINITY;
+    return;
+  }
+
+  center = BasicPoint<T>(static_cast<T>(a.x + x), static_cast<T>(a.y + y));
+  radius = static_cast<T>(sqrt(x * x + y * y));
+}
+
+template <typename T>
+BasicPoint<T> circumcenter(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c) {
+  double x, y;
+  if (!center_offset(a, b, c, x, y)) return a;
+  return BasicPoint<T>(static_cast<T>(a.x + x), static_cast<T>(a.y + y));
+}
+
+template <typename Traits>
+BasicTriangulation<Traits>* triangulate(const typename Traits::Scalar* xy,
+    size_t count,
+    size_t stride,
+    const Options& options) {
+  return triangulate<Traits>(xy, count, stride, options, nullptr);
+}
+
+template <typename Traits>
+BasicTriangulation<Traits>* triangulate(const typename Traits::Scalar* xy,
+    size_t count,
+    size_t stride,
+    const Options& options,
+    std::vector<uint32_t>* ids) {
+  typedef typename Traits::Scalar Scalar;
+  // The point each point merged into, empty without welding.
+  std::vector<uint32_t> remap;
+  if (options.m_weld) weld(xy, count, stride, Traits::tolerance(), remap);
+
+  if (options.m_engine == Engine::divide) {
+    BasicTriangulation<Traits>* tria;
+    if (remap.empty()) {
+      tria = divide_and_conquer<Traits>(xy, count, stride, options.m_threads, ids);
+    }
+    else {
+      // Hand over the kept points packed, rank maps each to its place.
+      std::vector<Scalar> kept;
+      std::vector<uint32_t> rank(count);
+      for (size_t i = 0; i < count; ++i) {
+        if (remap[i] != i) continue;
+        BasicPoint<Scalar> p = point_at(xy, stride, i);
+        rank[i] = static_cast<uint32_t>(kept.size() / 2);
+        kept.push_back(p.x);
+        kept.push_back(p.y);
+      }
+      std::vector<uint32_t> kept_ids;
+      tria = divide_and_conquer<Traits>(kept.data(),
+        kept.size() / 2,
+        2 * sizeof(Scalar),
+        options.m_threads,
+        ids ? &kept_ids : nullptr);
+      if (ids) {
+        ids->resize(count);
+        for (size_t i = 0; i < count; ++i) (*ids)[i] = kept_ids[rank[remap[i]]];
+      }
+    }
+    tria->set_kernel(options.m_kernel);
+    return tria;
+  }
+
+  BasicTriangulation<Traits>* tria = new BasicTriangulation<Traits>();
+  tria->set_kernel(options.m_kernel);
+  tria->set_locate(options.m_locate);
+  tria->reserve(count);
+
+  // Only the insertion order is materialized, the points stay where they are.
+  std::vector<uint32_t> order;
+  if (options.m_order == Order::brio) {
+    brio(xy, count, stride, options.m_curve, options.m_threads, order);
+  }
+  else {
+    order.resize(count);
+    for (size_t i = 0; i < count; ++i) order[i] = static_cast<uint32_t>(i);
+    std::random_shuffle(order.begin(), order.end());
+  }
+
+  if (ids) ids->assign(count, no_vertex);
+  tria->m_welded = !remap.empty();
+  for (uint32_t i : order) {
+    if (tria->m_welded && remap[i] != i) continue;
+    BasicPoint<Scalar> p = point_at(xy, stride, i);
+    uint32_t id = tria->insert(p);
+    if (!ids) continue;
+    (*ids)[i] = id != no_vertex ? id : tria->vertex_near(p);
+  }
+  tria->m_welded = false;
+  if (ids) {
+    for (size_t i = 0; i < remap.size(); ++i) (*ids)[i] = (*ids)[remap[i]];
+  }
   return tria;
 }
+
+Triangulation* triangulate(const float* xy,
+    size_t count,
+    size_t stride,
+    const Options& options) {
+  return triangulate<FloatTraits>(xy, count, stride, options);
+}
+
+DoubleTriangulation* triangulate(const double* xy,
+    size_t count,
+    size_t stride,
+    const Options& options) {
+  return triangulate<DoubleTraits>(xy, count, stride, options);
+}
+
+IntTriangulation* triangulate(const int32_t* xy,
+    size_t count,
+    size_t stride,
+    const Options& options) {
+  return triangulate<IntTraits>(xy, count, stride, options);
+}
+
+Triangulation* triangulate(const std::vector<float>& points,
+    const Options& options) {
+  return triangulate(points.data(), points.size() / 2, 2 * sizeof(float), options);
+}
+
+DoubleTriangulation* triangulate(const std::vector<double>& points,
+    const Options& options) {
+  return triangulate(points.data(), points.size() / 2, 2 * sizeof(double), options);
+}
+
+IntTriangulation* triangulate(const std::vector<int32_t>& points,
+    const Options& options) {
+  return triangulate(points.data(), points.size() / 2, 2 * sizeof(int32_t), options);
+}
+
+Triangulation* triangulate(const std::vector<float>& points,
+    const Options& options,
+    std::vector<uint32_t>* ids) {
+  return triangulate<FloatTraits>(points.data(), points.size() / 2, 2 * sizeof(float), options, ids);
+}
+
+DoubleTriangulation* triangulate(const std::vector<double>& points,
+    const Options& options,
+    std::vector<uint32_t>* ids) {
+  return triangulate<DoubleTraits>(points.data(), points.size() / 2, 2 * sizeof(double), options, ids);
+}
+
+IntTriangulation* triangulate(const std::vector<int32_t>& points,
+    const Options& options,
+    std::vector<uint32_t>* ids) {
+  return triangulate<IntTraits>(points.data(), points.size() / 2, 2 * sizeof(int32_t), options, ids);
+}
+
+template class BasicTriangulation<FloatTraits>;
+template class BasicTriangulation<DoubleTraits>;
+template class BasicTriangulation<FastFloatTraits>;
+template class BasicTriangulation<IntTraits>;
+
+template BasicTriangulation<FloatTraits>* triangulate<FloatTraits>(const float*,
+  size_t,
+  size_t,
+  const Options&);
+template BasicTriangulation<FloatTraits>* triangulate<FloatTraits>(const float*,
+  size_t,
+  size_t,
+  const Options&,
+  std::vector<uint32_t>*);
+template BasicTriangulation<DoubleTraits>* triangulate<DoubleTraits>(const double*,
+  size_t,
+  size_t,
+  const Options&);
+template BasicTriangulation<DoubleTraits>* triangulate<DoubleTraits>(const double*,
+  size_t,
+  size_t,
+  const Options&,
+  std::vector<uint32_t>*);
+template BasicTriangulation<FastFloatTraits>* triangulate<FastFloatTraits>(const float*,
+  size_t,
+  size_t,
+  const Options&);
+template BasicTriangulation<FastFloatTraits>* triangulate<FastFloatTraits>(const float*,
+  size_t,
+  size_t,
+  const Options&,
+  std::vector<uint32_t>*);
+template BasicTriangulation<IntTraits>* triangulate<IntTraits>(const int32_t*,
+  size_t,
+  size_t,
+  const Options&);
+template BasicTriangulation<IntTraits>* triangulate<IntTraits>(const int32_t*,
+  size_t,
+  size_t,
+  const Options&,
+  std::vector<uint32_t>*);
+
+template void circle(const Point&, const Point&, const Point&, Point&, float&);
+template void circle(const DoublePoint&, const DoublePoint&, const DoublePoint&, DoublePoint&, double&);
+template Point circumcenter(const Point&, const Point&, const Point&);
+template DoublePoint circumcenter(const DoublePoint&, const DoublePoint&, const DoublePoint&);
+
+}
@@ -0,0 +1,472 @@
+#include "divide.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "order.h"
+#include "parallel.h"
+#include "predicates.h"
+
+// The points are sorted by x, split in halves recursively and the
+// triangulations of neighboring halves are zipped together along the cut.
+// The top levels of the recursion each hand one half to a new thread, so
+// every slab below them is triangulated and merged without locks.
+
+namespace delaunay {
+
+// Below this many points per slab the recursion stays on one thread.
+const size_t s_points_per_slab = 1 << 14;
+
+template <typename Traits>
+using Vertex = BasicPoint<typename Traits::Scalar>;
+
+template <typename Traits>
+using Face = BasicTriNode<typename Traits::Scalar>;
+
+// One of the four directed edges of a quad edge. 0 and 2 are the two
+// directions of the primal edge, 1 and 3 those of its dual.
+template <typename Traits>
+struct Edge {
+  // Next edge counter clockwise around the origin.
+  Edge* m_next;
+  union {
+    // Origin of a primal edge.
+    const Vertex<Traits>* m_org;
+    // Origin of a dual edge, the triangle left of the primal edge it
+    // crosses. Only filled in once the triangulation is done.
+    Face<Traits>* m_face;
+  };
+};
+
+// Aligned to its size so an edge's index within it is in its address.
+template <typename Traits>
+struct alignas(4 * sizeof(Edge<Traits>)) QuadEdge {
+  Edge<Traits> m_e[4];
+};
+
+// Edges created by one thread, deleted ones are reused.
+template <typename Traits>
+using Slab = Arena<QuadEdge<Traits>>;
+
+template <typename E>
+int index(const E* e) {
+  return (reinterpret_cast<uintptr_t>(e) / sizeof(E)) & 3;
+}
+
+template <typename E>
+E* rot(E* e) {
+  return index(e) < 3 ? e + 1 : e - 3;
+}
+
+template <typename E>
+E* rot_inv(E* e) {
+  return index(e) > 0 ? e - 1 : e + 3;
+}
+
+template <typename E>
+E* sym(E* e) {
+  return index(e) < 2 ? e + 2 : e - 2;
+}
+
+template <typename E>
+E* onext(E* e) {
+  return e->m_next;
+}
+
+template <typename E>
+E* oprev(E* e) {
+  return rot(onext(rot(e)));
+}
+
+template <typename E>
+E* lnext(E* e) {
+  return rot(onext(rot_inv(e)));
+}
+
+template <typename E>
+E* rprev(E* e) {
+  return onext(sym(e));
+}
+
+template <typename Traits>
+const Vertex<Traits>& org(Edge<Traits>* e) {
+  return *e->m_org;
+}
+
+template <typename Traits>
+const Vertex<Traits>& dest(Edge<Traits>* e) {
+  return *sym(e)->m_org;
+}
+
+// Slot for the triangle left of the primal edge e.
+template <typename Traits>
+Face<Traits>*& left_face(Edge<Traits>* e) {
+  return rot_inv(e)->m_face;
+}
+
+template <typename Traits>
+Edge<Traits>* make_edge(Slab<Traits>& slab, const Vertex<Traits>* a, const Vertex<Traits>* b) {
+  QuadEdge<Traits>* q = slab.create();
+  Edge<Traits>* e = q->m_e;
+  e[0].m_next = &e[0];
+  e[1].m_next = &e[3];
+  e[2].m_next = &e[2];
+  e[3].m_next = &e[1];
+  e[0].m_org = a;
+  e[1].m_face = nullptr;
+  e[2].m_org = b;
+  e[3].m_face = nullptr;
+  return e;
+}
+
+// Joins the rings around a and b if they are separate, splits them if not.
+template <typename E>
+void splice(E* a, E* b) {
+  E* alpha = rot(onext(a));
+  E* beta = rot(onext(b));
+  std::swap(a->m_next, b->m_next);
+  std::swap(alpha->m_next, beta->m_next);
+}
+
+// New edge from the destination of a to the origin of b, sharing a's left
+// face.
+template <typename Traits>
+Edge<Traits>* connect(Slab<Traits>& slab, Edge<Traits>* a, Edge<Traits>* b) {
+  Edge<Traits>* e = make_edge(slab, sym(a)->m_org, b->m_org);
+  splice(e, lnext(a));
+  splice(sym(e), b);
+  return e;
+}
+
+// Unlinks e from the subdivision and hands its quad edge to slab for reuse.
+// Any thread that made it has finished by the time its edges are deleted.
+template <typename Traits>
+void delete_edge(Slab<Traits>& slab, Edge<Traits>* e) {
+  splice(e, oprev(e));
+  splice(sym(e), oprev(sym(e)));
+  QuadEdge<Traits>* q = reinterpret_cast<QuadEdge<Traits>*>(e - index(e));
+  // A null origin marks the quad edge as free, destroy only overwrites
+  // the first edge's ring pointer.
+  q->m_e[0].m_org = nullptr;
+  slab.destroy(q);
+}
+
+template <typename Traits>
+bool right_of(const Vertex<Traits>& p, Edge<Traits>* e) {
+  return Traits::Predicates::orient(p, dest(e), org(e)) > 0;
+}
+
+template <typename Traits>
+bool left_of(const Vertex<Traits>& p, Edge<Traits>* e) {
+  return Traits::Predicates::orient(p, org(e), dest(e)) > 0;
+}
+
+// Zips the triangulation left of the cut, with hull edges ldo and ldi, to
+// the one right of it, with hull edges rdi and rdo.
+template <typename Traits>
+void merge(Slab<Traits>& slab,
+    Edge<Traits>* ldo,
+    Edge<Traits>* ldi,
+    Edge<Traits>* rdi,
+    Edge<Traits>* rdo,
+    Edge<Traits>*& le,
+    Edge<Traits>*& re) {
+  typedef typename Traits::Predicates Predicates;
+  typedef Edge<Traits> Edge;
+  // Find the lower common tangent of the two hulls.
+  for (;;) {
+    if (left_of(org(rdi), ldi)) ldi = lnext(ldi);
+    else if (right_of(org(ldi), rdi)) rdi = rprev(rdi);
+    else break;
+  }
+
+  Edge* basel = connect(slab, sym(rdi), ldi);
+  if (ldi->m_org == ldo->m_org) ldo = sym(basel);
+  if (rdi->m_org == rdo->m_org) rdo = basel;
+
+  // Climb up the cut, each step adding the cross edge whose circle is empty
+  // and deleting the edges that circle shows to be illegal.
+  for (;;) {
+    Edge* lcand = onext(sym(basel));
+    bool lvalid = right_of(dest(lcand), basel);
+    if (lvalid) {
+      while (Predicates::incircle(dest(basel), org(basel), dest(lcand), dest(onext(lcand))) > 0) {
+        Edge* t = onext(lcand);
+        delete_edge(slab, lcand);
+        lcand = t;
+      }
+    }
+
+    Edge* rcand = oprev(basel);
+    bool rvalid = right_of(dest(rcand), basel);
+    if (rvalid) {
+      while (Predicates::incircle(dest(basel), org(basel), dest(rcand), dest(oprev(rcand))) > 0) {
+        Edge* t = oprev(rcand);
+        delete_edge(slab, rcand);
+        rcand = t;
+      }
+    }
+
+    // Reached the upper common tangent.
+    if (!lvalid && !rvalid) break;
+
+    if (!lvalid || (rvalid && Predicates::incircle(dest(lcand), org(lcand), org(rcand), dest(rcand)) > 0)) {
+      basel = connect(slab, rcand, sym(basel));
+    }
+    else {
+      basel = connect(slab, sym(basel), sym(lcand));
+    }
+  }
+
+  le = ldo;
+  re = rdo;
+}
+
+// Triangulates the n points at pts, sorted by x then y and at least two of
+// them. le is the counter clockwise hull edge out of the leftmost point and
+// re the clockwise hull edge out of the rightmost one. Above level 0 the left
+// half goes to a new thread, which uses the slab 2^(level - 1) slots on.
+template <typename Traits>
+void divide(const Vertex<Traits>* pts,
+    size_t n,
+    int level,
+    size_t slot,
+    Slab<Traits>* slabs,
+    Edge<Traits>*& le,
+    Edge<Traits>*& re) {
+  typedef Edge<Traits> Edge;
+  Slab<Traits>& slab = slabs[slot];
+  if (n == 2) {
+    le = make_edge(slab, &pts[0], &pts[1]);
+    re = sym(le);
+    return;
+  }
+
+  if (n == 3) {
+    Edge* a = make_edge(slab, &pts[0], &pts[1]);
+    Edge* b = make_edge(slab, &pts[1], &pts[2]);
+    splice(sym(a), b);
+    double o = Traits::Predicates::orient(pts[0], pts[1], pts[2]);
+    if (o > 0) {
+      connect(slab, b, a);
+      le = a;
+      re = sym(b);
+    }
+    else if (o < 0) {
+      Edge* c = connect(slab, b, a);
+      le = sym(c);
+      re = c;
+    }
+    else {
+      // Collinear, no triangle to close.
+      le = a;
+      re = sym(b);
+    }
+    return;
+  }
+
+  size_t half = n / 2;
+  Edge *ldo, *ldi, *rdi, *rdo;
+  if (level > 0) {
+    size_t other = slot + (static_cast<size_t>(1) << (level - 1));
+    std::thread left([&]() {
+      divide(pts, half, level - 1, other, slabs, ldo, ldi);
+    });
+    divide(pts + half, n - half, level - 1, slot, slabs, rdi, rdo);
+    left.join();
+  }
+  else {
+    divide(pts, half, 0, slot, slabs, ldo, ldi);
+    divide(pts + half, n - half, 0, slot, slabs, rdi, rdo);
+  }
+  merge(slab, ldo, ldi, rdi, rdo, le, re);
+}
+
+// Maps a float to an unsigned integer with the same order.
+uint32_t sort_key(float f) {
+  // Adding zero turns -0 into 0 so both sort together.
+  f += 0.0f;
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+// Maps an int32 to an unsigned integer with the same order.
+uint32_t sort_key(int32_t i) {
+  return static_cast<uint32_t>(i) ^ 0x80000000u;
+}
+
+// Fills order with the indices of the count points in xy sorted by x, then
+// y. Floats and ints fit the radix sort's keys, two stable passes, y first.
+template <typename T>
+void sort_xy(const T* xy, size_t count, size_t stride, unsigned threads, std::vector<uint32_t>& order) {
+  std::vector<uint64_t> items(count);
+  for (size_t i = 0; i < count; ++i) {
+    items[i] = (static_cast<uint64_t>(sort_key(point_at(xy, stride, i).y)) << 32) | i;
+  }
+  radix_sort(items, threads);
+  for (auto& item : items) {
+    uint32_t i = static_cast<uint32_t>(item);
+    item = (static_cast<uint64_t>(sort_key(point_at(xy, stride, i).x)) << 32) | i;
+  }
+  radix_sort(items, threads);
+
+  order.resize(count);
+  for (size_t i = 0; i < count; ++i) order[i] = static_cast<uint32_t>(items[i]);
+}
+
+// Doubles don't, they are compared instead.
+void sort_xy(const double* xy, size_t count, size_t stride, unsigned, std::vector<uint32_t>& order) {
+  order.resize(count);
+  for (size_t i = 0; i < count; ++i) order[i] = static_cast<uint32_t>(i);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    DoublePoint p = point_at(xy, stride, a);
+    DoublePoint q = point_at(xy, stride, b);
+    return p.x < q.x || (p.x == q.x && (p.y + 0.0) < (q.y + 0.0));
+  });
+}
+
+template <typename Traits>
+BasicTriangulation<Traits>* divide_and_conquer(const typename Traits::Scalar* xy,
+    size_t count,
+    size_t stride,
+    unsigned threads,
+    std::vector<uint32_t>* ids) {
+  typedef typename BasicTriangulation<Traits>::Point Point;
+  typedef typename BasicTriangulation<Traits>::TriNode TriNode;
+  typedef Edge<Traits> Edge;
+  typedef QuadEdge<Traits> QuadEdge;
+  typedef Slab<Traits> Slab;
+
+  std::vector<uint32_t> order;
+  sort_xy(xy, count, stride, threads, order);
+  std::vector<Point> pts;
+  pts.reserve(order.size());
+  if (ids) ids->resize(count);
+  for (uint32_t i : order) {
+    Point p = point_at(xy, stride, i);
+    if (pts.empty() || pts.back() != p) pts.push_back(p);
+    if (ids) (*ids)[i] = static_cast<uint32_t>(pts.size() - 1);
+  }
+  std::vector<uint32_t>().swap(order);
+
+  BasicTriangulation<Traits>* tria = new BasicTriangulation<Traits>();
+  tria->m_history = false;
+  tria->m_locate = Locate::walk;
+  tria->m_incident.resize(pts.size());
+  if (pts.size() < 3) {
+    // Too few to triangulate, insert takes it from here.
+    tria->m_points.swap(pts);
+    for (uint32_t i = 0; i < tria->m_points.size(); ++i) tria->m_pending.push_back(i);
+    return tria;
+  }
+
+  // Each thread at the top levels gets its own slab of at least
+  // s_points_per_slab points.
+  unsigned t = thread_count(threads);
+  int levels = 0;
+  while ((2u << levels) <= t && (pts.size() >> (levels + 1)) >= s_points_per_slab) ++levels;
+  std::unique_ptr<Slab[]> slabs(new Slab[static_cast<size_t>(1) << levels]);
+
+  Edge* le;
+  Edge* re;
+  divide(pts.data(), pts.size(), levels, 0, slabs.get(), le, re);
+
+  // The sorted points become the vertex table, the edges point into it.
+  tria->m_points.swap(pts);
+  const Point* base = tria->m_points.data();
+
+  // Walk the edges in the order each slab made them, which keeps nearby
+  // triangles close in memory. Each triangle is made once, from the edge
+  // with the lowest origin address, and the outer face runs clockwise.
+  size_t slab_count = static_cast<size_t>(1) << levels;
+  for (size_t i = 0; i < slab_count; ++i) {
+    slabs[i].for_each([&](QuadEdge* q) {
+      if (!q->m_e[0].m_org) return;
+      for (int r = 0; r < 4; r += 2) {
+        Edge* e = &q->m_e[r];
+        Edge* f = lnext(e);
+        Edge* g = lnext(f);
+        if (lnext(g) != e || f->m_org < e->m_org || g->m_org < e->m_org) continue;
+        if (Traits::Predicates::orient(org(e), org(f), org(g)) <= 0) continue;
+        TriNode* node = tria->make_leaf(static_cast<uint32_t>(e->m_org - base),
+          static_cast<uint32_t>(f->m_org - base),
+          static_cast<uint32_t>(g->m_org - base));
+        left_face(e) = left_face(f) = left_face(g) = node;
+        if (!tria->m_last) tria->m_last = node;
+      }
+    });
+  }
+
+  // Every point on one line, insert takes it from here.
+  if (!tria->m_last) {
+    for (uint32_t i = 0; i < tria->m_points.size(); ++i) tria->m_pending.push_back(i);
+    return tria;
+  }
+
+  // What is left of each hull edge is outside, a ghost goes there.
+  for (size_t i = 0; i < slab_count; ++i) {
+    slabs[i].for_each([&](QuadEdge* q) {
+      if (!q->m_e[0].m_org) return;
+      for (int r = 0; r < 4; r += 2) {
+        Edge* e = &q->m_e[r];
+        if (left_face(e)) continue;
+        left_face(e) = tria->make_leaf(static_cast<uint32_t>(e->m_org - base),
+          static_cast<uint32_t>(sym(e)->m_org - base),
+          infinite_vertex);
+      }
+    });
+  }
+
+  for (size_t i = 0; i < slab_count; ++i) {
+    slabs[i].for_each([&](QuadEdge* q) {
+      if (!q->m_e[0].m_org) return;
+      for (int r = 0; r < 4; r += 2) {
+        Edge* e = &q->m_e[r];
+        TriNode* node = left_face(e);
+        if (node->is_ghost()) {
+          // The outer face runs clockwise, so the next ghost along it
+          // shares the edge out to infinity from the destination of e.
+          TriNode* next = left_face(lnext(e));
+          node->m_neighbors[0] = left_face(sym(e));
+          node->m_neighbors[1] = next;
+          next->m_neighbors[2] = node;
+          continue;
+        }
+        uint32_t id = static_cast<uint32_t>(e->m_org - base);
+        int j = 0;
+        while (node->m_ids[j] != id) ++j;
+        node->m_neighbors[j] = left_face(sym(e));
+      }
+    });
+  }
+
+  return tria;
+}
+
+template Triangulation* divide_and_conquer<FloatTraits>(const float*,
+  size_t,
+  size_t,
+  unsigned,
+  std::vector<uint32_t>*);
+template DoubleTriangulation* divide_and_conquer<DoubleTraits>(const double*,
+  size_t,
+  size_t,
+  unsigned,
+  std::vector<uint32_t>*);
+template BasicTriangulation<FastFloatTraits>* divide_and_conquer<FastFloatTraits>(const float*,
+  size_t,
+  size_t,
+  unsigned,
+  std::vector<uint32_t>*);
+template IntTriangulation* divide_and_conquer<IntTraits>(const int32_t*,
+  size_t,
+  size_t,
+  unsigned,
+  std::vector<uint32_t>*);
+
+}
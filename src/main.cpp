@@ -29,9 +29,10 @@ GLuint vao_circle;
 GLuint cvbo = 0;
 GLuint tvao = 0;
 GLuint tvbo = 0;
+GLuint tibo = 0;
 
 std::vector<GLfloat> points;
-std::vector<GLfloat> tpoints;
+std::vector<GLuint> tindices;
 
 delaunay::Triangulation* tria = nullptr;
 
@@ -62,6 +63,14 @@ void set_selected(glm::vec3& selected, double xpos, double ypos) {
 }
 
 void add_point(const glm::vec3& pt) {
+  // The point buffer is full.
+  if (pidx + 3 > points.size()) return;
+
+  if (!tria) tria = new delaunay::Triangulation();
+
+  // Skip duplicates.
+  if (tria->insert(delaunay::Point(pt.x, pt.y)) == delaunay::no_vertex) return;
+
   points[pidx++] = pt.x;
   points[pidx++] = pt.y;
   points[pidx++] = pt.z;
@@ -70,42 +79,29 @@ void add_point(const glm::vec3& pt) {
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
   glBufferSubData(GL_ARRAY_BUFFER, (pidx - 3) * sizeof(GLfloat), 3 * sizeof(GLfloat), &pt[0]);
 
-  std::vector<float> pts;
-  uint32_t i = 0;
-  while (i < pidx) {
-    pts.push_back(points[i]);
-    pts.push_back(points[i + 1]);
-    i += 3;
-  }
-
-  tria = delaunay::triangulate(pts);
-  std::vector<float> d = tria->get_tris();
-  // Make it 3d.
-  tpoints.clear();
-  tpoints.resize(d.size() + d.size() / 2);
-
-  size_t d3i = 0;
-  for (size_t i = 0; i < d.size(); i += 2) {
-    tpoints[d3i++] = d[i];
-    tpoints[d3i++] = d[i + 1];
-    tpoints[d3i++] = 0.0f;
-  }
+  // Upload the shared vertex table as is, x and y with z left at 0, and
+  // index it.
+  const std::vector<delaunay::Point>& verts = tria->get_vertices();
+  tindices = tria->get_indices();
 
   glBindVertexArray(0);
 
   glDeleteVertexArrays(1, &tvao);
   glDeleteBuffers(1, &tvbo);
-
+  glDeleteBuffers(1, &tibo);
 
   glGenVertexArrays(1, &tvao);
   glBindVertexArray(tvao);
 
   glGenBuffers(1, &tvbo);
   glBindBuffer(GL_ARRAY_BUFFER, tvbo);
-  glBufferData(GL_ARRAY_BUFFER, tpoints.size() * sizeof(GLfloat), tpoints.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(delaunay::Point), verts.data(), GL_STATIC_DRAW);
   glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  std::cout << "TEST" << std::endl;
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+  glGenBuffers(1, &tibo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, tindices.size() * sizeof(GLuint), tindices.data(), GL_STATIC_DRAW);
 }
 
 void mouse_callback(GLFWwindow* window, int button, int action, int mods) {
@@ -307,7 +303,7 @@ int main() {
       glUniformMatrix4fv(modl2, 1, GL_FALSE, &model[0][0]);
 
       glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-      glDrawArrays(GL_TRIANGLES, 0, tpoints.size());
+      glDrawElements(GL_TRIANGLES, tindices.size(), GL_UNSIGNED_INT, NULL);
       glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
 
@@ -0,0 +1,188 @@
+#include "order.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "parallel.h"
+
+namespace delaunay {
+
+// Bits per axis of the quantized curve keys, leaving the top bits of the 32
+// bit sort key for the round.
+const int s_curve_bits = 13;
+const int s_round_bits = 32 - 2 * s_curve_bits;
+
+// Below this many items per thread the sort runs on one thread.
+const size_t s_items_per_thread = 1 << 16;
+
+uint32_t hilbert_key(uint32_t x, uint32_t y, int bits) {
+  uint32_t n = 1u << bits;
+  uint32_t d = 0;
+  for (uint32_t s = n >> 1; s > 0; s >>= 1) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+    // Rotate the quadrant so the sub-curve is in standard orientation.
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+// Spreads the low 16 bits of v out to the even bits.
+uint32_t spread(uint32_t v) {
+  v &= 0xffff;
+  v = (v | (v << 8)) & 0x00ff00ff;
+  v = (v | (v << 4)) & 0x0f0f0f0f;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+
+uint32_t morton_key(uint32_t x, uint32_t y, int bits) {
+  uint32_t mask = bits >= 16 ? 0xffff : (1u << bits) - 1;
+  return spread(x & mask) | (spread(y & mask) << 1);
+}
+
+void radix_sort(std::vector<uint64_t>& items, unsigned threads) {
+  size_t n = items.size();
+  unsigned t = std::max<size_t>(1, std::min<size_t>(thread_count(threads), n / s_items_per_thread));
+  std::vector<uint64_t> tmp(n);
+  std::vector<size_t> offsets(t * 256);
+
+  for (int shift = 32; shift < 64; shift += 8) {
+    std::fill(offsets.begin(), offsets.end(), 0);
+    parallel_for(n, t, [&](size_t begin, size_t end, unsigned thread) {
+      size_t* counts = &offsets[thread * 256];
+      for (size_t i = begin; i < end; ++i) ++counts[(items[i] >> shift) & 0xff];
+    });
+
+    // Every digit is the same, nothing would move.
+    bool skip = false;
+    for (size_t d = 0; d < 256 && !skip; ++d) {
+      size_t total = 0;
+      for (unsigned i = 0; i < t; ++i) total += offsets[i * 256 + d];
+      skip = total == n;
+    }
+    if (skip) continue;
+
+    // Each thread scatters its range after all smaller digits and after
+    // the same digit from earlier ranges, which keeps the sort stable.
+    size_t sum = 0;
+    for (size_t d = 0; d < 256; ++d) {
+      for (unsigned i = 0; i < t; ++i) {
+        size_t count = offsets[i * 256 + d];
+        offsets[i * 256 + d] = sum;
+        sum += count;
+      }
+    }
+
+    parallel_for(n, t, [&](size_t begin, size_t end, unsigned thread) {
+      size_t* next = &offsets[thread * 256];
+      for (size_t i = begin; i < end; ++i) tmp[next[(items[i] >> shift) & 0xff]++] = items[i];
+    });
+    items.swap(tmp);
+  }
+}
+
+// Number of consecutive heads before the first tail of a coin flipped
+// with a hash of i.
+int coin_flips(uint32_t i) {
+  uint32_t h = i * 0x9e3779b1u;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  int heads = 0;
+  while (h & 1) {
+    ++heads;
+    h >>= 1;
+  }
+  return heads;
+}
+
+// Sorts the points into order along curve, within rounds of doubling size
+// that each point is assigned to at random.
+template <typename T>
+void sort_rounds(const T* xy,
+    size_t count,
+    size_t stride,
+    Curve curve,
+    int rounds,
+    unsigned threads,
+    std::vector<uint32_t>& order) {
+  size_t n = count;
+  order.resize(n);
+  if (n < 2) {
+    for (size_t i = 0; i < n; ++i) order[i] = static_cast<uint32_t>(i);
+    return;
+  }
+
+  const T big = std::numeric_limits<T>::max();
+  T min_x = big, min_y = big, max_x = -big, max_y = -big;
+  for (size_t i = 0; i < n; ++i) {
+    BasicPoint<T> p = point_at(xy, stride, i);
+    min_x = std::min(min_x, p.x);
+    min_y = std::min(min_y, p.y);
+    max_x = std::max(max_x, p.x);
+    max_y = std::max(max_y, p.y);
+  }
+  double extent = std::max(static_cast<double>(max_x) - min_x, static_cast<double>(max_y) - min_y);
+  double scale = extent > 0 ? ((1 << s_curve_bits) - 1) / extent : 0.0;
+
+  std::vector<uint64_t> items(n);
+  parallel_for(n, threads, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; ++i) {
+      BasicPoint<T> p = point_at(xy, stride, i);
+      uint32_t x = static_cast<uint32_t>((static_cast<double>(p.x) - min_x) * scale);
+      uint32_t y = static_cast<uint32_t>((static_cast<double>(p.y) - min_y) * scale);
+      uint32_t key = curve == Curve::hilbert
+        ? hilbert_key(x, y, s_curve_bits)
+        : morton_key(x, y, s_curve_bits);
+      uint32_t round = std::max(0, rounds - 1 - coin_flips(static_cast<uint32_t>(i)));
+      key |= round << (2 * s_curve_bits);
+      items[i] = (static_cast<uint64_t>(key) << 32) | static_cast<uint32_t>(i);
+    }
+  });
+
+  radix_sort(items, threads);
+
+  for (size_t i = 0; i < n; ++i) order[i] = static_cast<uint32_t>(items[i]);
+}
+
+template <typename T>
+void brio(const T* xy,
+    size_t count,
+    size_t stride,
+    Curve curve,
+    unsigned threads,
+    std::vector<uint32_t>& order) {
+  // The last round gets half the points, the one before a quarter and so
+  // on, until the first round is down to a handful.
+  int rounds = 1;
+  while (rounds < (1 << s_round_bits) - 1 && (count >> rounds) > 32) ++rounds;
+  sort_rounds(xy, count, stride, curve, rounds, threads, order);
+}
+
+template <typename T>
+void curve_order(const T* xy,
+    size_t count,
+    size_t stride,
+    Curve curve,
+    unsigned threads,
+    std::vector<uint32_t>& order) {
+  sort_rounds(xy, count, stride, curve, 1, threads, order);
+}
+
+template void brio(const float*, size_t, size_t, Curve, unsigned, std::vector<uint32_t>&);
+template void brio(const double*, size_t, size_t, Curve, unsigned, std::vector<uint32_t>&);
+template void brio(const int32_t*, size_t, size_t, Curve, unsigned, std::vector<uint32_t>&);
+template void curve_order(const float*, size_t, size_t, Curve, unsigned, std::vector<uint32_t>&);
+template void curve_order(const double*, size_t, size_t, Curve, unsigned, std::vector<uint32_t>&);
+template void curve_order(const int32_t*, size_t, size_t, Curve, unsigned, std::vector<uint32_t>&);
+
+}
@@ -0,0 +1,731 @@
+#include "predicates.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#ifdef DELAUNAY_PREDICATE_STATS
+#include <atomic>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "delaunay.h"
+
+// Floating point filters and exact fallbacks after Shewchuk, "Adaptive
+// Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates".
+// An expansion is an array of doubles of increasing magnitude, none of which
+// overlap, whose exact sum is the represented value.
+
+namespace delaunay {
+
+#ifdef DELAUNAY_PREDICATE_STATS
+// Relaxed, the threads of a build count into the same totals and only the
+// sums matter.
+struct AtomicStats {
+  std::atomic<uint64_t> m_orient;
+  std::atomic<uint64_t> m_orient_exact;
+  std::atomic<uint64_t> m_incircle;
+  std::atomic<uint64_t> m_incircle_exact;
+};
+
+AtomicStats s_stats;
+
+PredicateStats predicate_stats() {
+  PredicateStats stats;
+  stats.m_orient = s_stats.m_orient.load(std::memory_order_relaxed);
+  stats.m_orient_exact = s_stats.m_orient_exact.load(std::memory_order_relaxed);
+  stats.m_incircle = s_stats.m_incircle.load(std::memory_order_relaxed);
+  stats.m_incircle_exact = s_stats.m_incircle_exact.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void reset_predicate_stats() {
+  s_stats.m_orient.store(0, std::memory_order_relaxed);
+  s_stats.m_orient_exact.store(0, std::memory_order_relaxed);
+  s_stats.m_incircle.store(0, std::memory_order_relaxed);
+  s_stats.m_incircle_exact.store(0, std::memory_order_relaxed);
+}
+
+#define COUNT(field) s_stats.field.fetch_add(1, std::memory_order_relaxed)
+#define COUNT_N(field, n) s_stats.field.fetch_add(n, std::memory_order_relaxed)
+#else
+#define COUNT(field)
+#define COUNT_N(field, n)
+#endif
+
+// Half an ulp of 1.0.
+const double s_epsilon = 1.1102230246251565e-16;
+const double s_orient_bound = (3.0 + 16.0 * s_epsilon) * s_epsilon;
+const double s_incircle_bound = (10.0 + 96.0 * s_epsilon) * s_epsilon;
+
+// x + y == a + b exactly.
+void two_sum(double a, double b, double& x, double& y) {
+  x = a + b;
+  double bv = x - a;
+  double av = x - bv;
+  y = (a - av) + (b - bv);
+}
+
+// Requires |a| >= |b|.
+void fast_two_sum(double a, double b, double& x, double& y) {
+  x = a + b;
+  y = b - (x - a);
+}
+
+// x + y == a - b exactly.
+void two_diff(double a, double b, double& x, double& y) {
+  x = a - b;
+  double bv = a - x;
+  double av = x + bv;
+  y = (a - av) + (bv - b);
+}
+
+// x + y == a * b exactly.
+void two_product(double a, double b, double& x, double& y) {
+  x = a * b;
+  y = std::fma(a, b, -x);
+}
+
+// h = e + b. h may alias e and needs room for elen + 1 terms.
+int grow(int elen, const double* e, double b, double* h) {
+  double q = b;
+  int hlen = 0;
+  for (int i = 0; i < elen; ++i) {
+    double hh;
+    two_sum(q, e[i], q, hh);
+    if (hh != 0.0) h[hlen++] = hh;
+  }
+  if (q != 0.0 || hlen == 0) h[hlen++] = q;
+  return hlen;
+}
+
+// h = e + f. h must not alias f and needs room for elen + flen terms.
+int sum(int elen, const double* e, int flen, const double* f, double* h) {
+  for (int i = 0; i < elen; ++i) h[i] = e[i];
+  int hlen = elen;
+  for (int i = 0; i < flen; ++i) hlen = grow(hlen, h, f[i], h);
+  return hlen;
+}
+
+// h = e * b. h needs room for 2 * elen terms.
+int scale(int elen, const double* e, double b, double* h) {
+  double q, hh;
+  int hlen = 0;
+  two_product(e[0], b, q, hh);
+  if (hh != 0.0) h[hlen++] = hh;
+  for (int i = 1; i < elen; ++i) {
+    double p1, p0, s;
+    two_product(e[i], b, p1, p0);
+    two_sum(q, p0, s, hh);
+    if (hh != 0.0) h[hlen++] = hh;
+    fast_two_sum(p1, s, q, hh);
+    if (hh != 0.0) h[hlen++] = hh;
+  }
+  if (q != 0.0 || hlen == 0) h[hlen++] = q;
+  return hlen;
+}
+
+// h = e * f for expansions of at most 16 terms each.
+int mul(int elen, const double* e, int flen, const double* f, double* h) {
+  double scaled[32];
+  double acc[512];
+  int hlen = 1;
+  h[0] = 0.0;
+  for (int i = 0; i < flen; ++i) {
+    int slen = scale(elen, e, f[i], scaled);
+    for (int j = 0; j < hlen; ++j) acc[j] = h[j];
+    hlen = sum(hlen, acc, slen, scaled, h);
+  }
+  return hlen;
+}
+
+void negate(int elen, double* e) {
+  for (int i = 0; i < elen; ++i) e[i] = -e[i];
+}
+
+// h = a * b - c * d where each input is a two term expansion.
+int cross(const double* a, const double* b, const double* c, const double* d, double* h) {
+  double ab[8], cd[8];
+  int ablen = mul(2, a, 2, b, ab);
+  int cdlen = mul(2, c, 2, d, cd);
+  negate(cdlen, cd);
+  return sum(ablen, ab, cdlen, cd, h);
+}
+
+template <typename T>
+double orient_exact(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c) {
+  double acx[2], acy[2], bcx[2], bcy[2];
+  two_diff(a.x, c.x, acx[1], acx[0]);
+  two_diff(a.y, c.y, acy[1], acy[0]);
+  two_diff(b.x, c.x, bcx[1], bcx[0]);
+  two_diff(b.y, c.y, bcy[1], bcy[0]);
+
+  double det[16];
+  int len = cross(acx, bcy, acy, bcx, det);
+  return det[len - 1];
+}
+
+template <typename T>
+double incircle_exact(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c, const BasicPoint<T>& d) {
+  double adx[2], ady[2], bdx[2], bdy[2], cdx[2], cdy[2];
+  two_diff(a.x, d.x, adx[1], adx[0]);
+  two_diff(a.y, d.y, ady[1], ady[0]);
+  two_diff(b.x, d.x, bdx[1], bdx[0]);
+  two_diff(b.y, d.y, bdy[1], bdy[0]);
+  two_diff(c.x, d.x, cdx[1], cdx[0]);
+  two_diff(c.y, d.y, cdy[1], cdy[0]);
+
+  // Each term is lift(p) * cross(q, r) for the rotations of a, b, c.
+  const double* dx[3] = { adx, bdx, cdx };
+  const double* dy[3] = { ady, bdy, cdy };
+  double terms[3][512];
+  int lens[3];
+  for (int i = 0; i < 3; ++i) {
+    int j = (i + 1) % 3, k = (i + 2) % 3;
+    double xx[8], yy[8], lift[16], minor[16];
+    int xxlen = mul(2, dx[i], 2, dx[i], xx);
+    int yylen = mul(2, dy[i], 2, dy[i], yy);
+    int liftlen = sum(xxlen, xx, yylen, yy, lift);
+    int minorlen = cross(dx[j], dy[k], dx[k], dy[j], minor);
+    lens[i] = mul(liftlen, lift, minorlen, minor, terms[i]);
+  }
+
+  double ab[1024], det[1536];
+  int ablen = sum(lens[0], terms[0], lens[1], terms[1], ab);
+  int len = sum(ablen, ab, lens[2], terms[2], det);
+  return det[len - 1];
+}
+
+template <typename T>
+double orient(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c) {
+  COUNT(m_orient);
+  double left = (static_cast<double>(a.x) - c.x) * (static_cast<double>(b.y) - c.y);
+  double right = (static_cast<double>(a.y) - c.y) * (static_cast<double>(b.x) - c.x);
+  double det = left - right;
+
+  // The filter only matters when both products have the same sign.
+  double detsum;
+  if (left > 0.0) {
+    if (right <= 0.0) return det;
+    detsum = left + right;
+  }
+  else if (left < 0.0) {
+    if (right >= 0.0) return det;
+    detsum = -left - right;
+  }
+  else {
+    return det;
+  }
+
+  double bound = s_orient_bound * detsum;
+  if (det >= bound || -det >= bound) return det;
+  COUNT(m_orient_exact);
+  return orient_exact(a, b, c);
+}
+
+template <typename T>
+double incircle(const BasicPoint<T>& a, const BasicPoint<T>& b, const BasicPoint<T>& c, const BasicPoint<T>& d) {
+  COUNT(m_incircle);
+  double adx = static_cast<double>(a.x) - d.x, ady = static_cast<double>(a.y) - d.y;
+  double bdx = static_cast<double>(b.x) - d.x, bdy = static_cast<double>(b.y) - d.y;
+  double cdx = static_cast<double>(c.x) - d.x, cdy = static_cast<double>(c.y) - d.y;
+
+  double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+  double cdxady = cdx * ady, adxcdy = adx * cdy;
+  double adxbdy = adx * bdy, bdxady = bdx * ady;
+  double alift = adx * adx + ady * ady;
+  double blift = bdx * bdx + bdy * bdy;
+  double clift = cdx * cdx + cdy * cdy;
+
+  double det = alift * (bdxcdy - cdxbdy)
+    + blift * (cdxady - adxcdy)
+    + clift * (adxbdy - bdxady);
+
+  double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift
+    + (fabs(cdxady) + fabs(adxcdy)) * blift
+    + (fabs(adxbdy) + fabs(bdxady)) * clift;
+  double bound = s_incircle_bound * permanent;
+  if (det > bound || -det > bound) return det;
+  COUNT(m_incircle_exact);
+  return incircle_exact(a, b, c, d);
+}
+
+#ifdef __SIZEOF_INT128__
+typedef __int128 Wide;
+
+double sign(Wide v) {
+  return v > 0 ? 1.0 : (v < 0 ? -1.0 : 0.0);
+}
+
+// Differences of int32 coordinates take 33 bits and the products 66, so the
+// determinant is exact in a 128 bit integer.
+template <>
+double orient(const BasicPoint<int32_t>& a, const BasicPoint<int32_t>& b, const BasicPoint<int32_t>& c) {
+  COUNT(m_orient);
+  Wide acx = static_cast<int64_t>(a.x) - c.x, acy = static_cast<int64_t>(a.y) - c.y;
+  Wide bcx = static_cast<int64_t>(b.x) - c.x, bcy = static_cast<int64_t>(b.y) - c.y;
+  return static_cast<double>(acx * bcy - acy * bcx);
+}
+
+// With every difference below 2^30 the lifts and crosses fit in 62 bits and
+// only their products need 128. Beyond that the lifts and crosses take 65
+// bits and the products 130, one too many, so each cross is split at bit
+// 32 and the two halves of the terms are summed apart. Only the sign comes
+// back, converting 128 bits to a double costs more than the rest.
+template <>
+double incircle(const BasicPoint<int32_t>& a,
+    const BasicPoint<int32_t>& b,
+    const BasicPoint<int32_t>& c,
+    const BasicPoint<int32_t>& d) {
+  COUNT(m_incircle);
+  int64_t adx = static_cast<int64_t>(a.x) - d.x, ady = static_cast<int64_t>(a.y) - d.y;
+  int64_t bdx = static_cast<int64_t>(b.x) - d.x, bdy = static_cast<int64_t>(b.y) - d.y;
+  int64_t cdx = static_cast<int64_t>(c.x) - d.x, cdy = static_cast<int64_t>(c.y) - d.y;
+
+  uint64_t reach = std::llabs(adx) | std::llabs(ady) | std::llabs(bdx) | std::llabs(bdy)
+    | std::llabs(cdx) | std::llabs(cdy);
+  if (reach < (1u << 30)) {
+    int64_t alift = adx * adx + ady * ady;
+    int64_t blift = bdx * bdx + bdy * bdy;
+    int64_t clift = cdx * cdx + cdy * cdy;
+    return sign(static_cast<Wide>(alift) * (bdx * cdy - cdx * bdy)
+      + static_cast<Wide>(blift) * (cdx * ady - adx * cdy)
+      + static_cast<Wide>(clift) * (adx * bdy - bdx * ady));
+  }
+
+  Wide lift[3] = {
+    static_cast<Wide>(adx) * adx + static_cast<Wide>(ady) * ady,
+    static_cast<Wide>(bdx) * bdx + static_cast<Wide>(bdy) * bdy,
+    static_cast<Wide>(cdx) * cdx + static_cast<Wide>(cdy) * cdy,
+  };
+  Wide cross[3] = {
+    static_cast<Wide>(bdx) * cdy - static_cast<Wide>(cdx) * bdy,
+    static_cast<Wide>(cdx) * ady - static_cast<Wide>(adx) * cdy,
+    static_cast<Wide>(adx) * bdy - static_cast<Wide>(bdx) * ady,
+  };
+
+  // high * 2^32 + low, low kept in [0, 2^32) so the sign is high's unless
+  // high is zero.
+  Wide high = 0, low = 0;
+  for (int i = 0; i < 3; ++i) {
+    high += lift[i] * (cross[i] >> 32);
+    low += lift[i] * (cross[i] & 0xffffffff);
+  }
+  high += low >> 32;
+  low &= 0xffffffff;
+  return high != 0 ? sign(high) : sign(low);
+}
+
+// Lanes the batch filters leave unsure need no expansions either.
+template <>
+double orient_exact(const BasicPoint<int32_t>& a, const BasicPoint<int32_t>& b, const BasicPoint<int32_t>& c) {
+  return orient(a, b, c);
+}
+
+template <>
+double incircle_exact(const BasicPoint<int32_t>& a,
+    const BasicPoint<int32_t>& b,
+    const BasicPoint<int32_t>& c,
+    const BasicPoint<int32_t>& d) {
+  return incircle(a, b, c, d);
+}
+#endif
+
+// Four doubles, one per lane of a batch, in the widest registers the
+// target has. Floats and int32s widen to doubles exactly, so the batched
+// filters compute exactly what orient and incircle do.
+#if defined(__AVX__)
+struct Lanes {
+  __m256d v;
+};
+
+inline Lanes widen(const float* p) {
+  Lanes r = { _mm256_cvtps_pd(_mm_loadu_ps(p)) };
+  return r;
+}
+
+inline Lanes widen(const double* p) {
+  Lanes r = { _mm256_loadu_pd(p) };
+  return r;
+}
+
+inline Lanes widen(const int32_t* p) {
+  Lanes r = { _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) };
+  return r;
+}
+
+inline Lanes splat(double d) {
+  Lanes r = { _mm256_set1_pd(d) };
+  return r;
+}
+
+inline Lanes operator+(Lanes a, Lanes b) {
+  Lanes r = { _mm256_add_pd(a.v, b.v) };
+  return r;
+}
+
+inline Lanes operator-(Lanes a, Lanes b) {
+  Lanes r = { _mm256_sub_pd(a.v, b.v) };
+  return r;
+}
+
+inline Lanes operator*(Lanes a, Lanes b) {
+  Lanes r = { _mm256_mul_pd(a.v, b.v) };
+  return r;
+}
+
+inline Lanes abs(Lanes a) {
+  Lanes r = { _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v) };
+  return r;
+}
+
+// Bit i set where lane i of a is greater than that of b, never for NaN.
+inline unsigned greater(Lanes a, Lanes b) {
+  return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)));
+}
+
+inline unsigned equal(Lanes a, Lanes b) {
+  return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ)));
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Lanes {
+  __m128d lo;
+  __m128d hi;
+};
+
+inline Lanes widen(const float* p) {
+  __m128 f = _mm_loadu_ps(p);
+  Lanes r = { _mm_cvtps_pd(f), _mm_cvtps_pd(_mm_movehl_ps(f, f)) };
+  return r;
+}
+
+inline Lanes widen(const double* p) {
+  Lanes r = { _mm_loadu_pd(p), _mm_loadu_pd(p + 2) };
+  return r;
+}
+
+inline Lanes widen(const int32_t* p) {
+  __m128i i = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  Lanes r = { _mm_cvtepi32_pd(i), _mm_cvtepi32_pd(_mm_shuffle_epi32(i, _MM_SHUFFLE(1, 0, 3, 2))) };
+  return r;
+}
+
+inline Lanes splat(double d) {
+  Lanes r = { _mm_set1_pd(d), _mm_set1_pd(d) };
+  return r;
+}
+
+inline Lanes operator+(Lanes a, Lanes b) {
+  Lanes r = { _mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi) };
+  return r;
+}
+
+inline Lanes operator-(Lanes a, Lanes b) {
+  Lanes r = { _mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi) };
+  return r;
+}
+
+inline Lanes operator*(Lanes a, Lanes b) {
+  Lanes r = { _mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi) };
+  return r;
+}
+
+inline Lanes abs(Lanes a) {
+  __m128d sign = _mm_set1_pd(-0.0);
+  Lanes r = { _mm_andnot_pd(sign, a.lo), _mm_andnot_pd(sign, a.hi) };
+  return r;
+}
+
+inline unsigned greater(Lanes a, Lanes b) {
+  return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpgt_pd(a.lo, b.lo))
+    | (_mm_movemask_pd(_mm_cmpgt_pd(a.hi, b.hi)) << 2));
+}
+
+inline unsigned equal(Lanes a, Lanes b) {
+  return static_cast<unsigned>(_mm_movemask_pd(_mm_cmpeq_pd(a.lo, b.lo))
+    | (_mm_movemask_pd(_mm_cmpeq_pd(a.hi, b.hi)) << 2));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+struct Lanes {
+  float64x2_t lo;
+  float64x2_t hi;
+};
+
+inline Lanes widen(const float* p) {
+  float32x4_t f = vld1q_f32(p);
+  Lanes r = { vcvt_f64_f32(vget_low_f32(f)), vcvt_high_f64_f32(f) };
+  return r;
+}
+
+inline Lanes widen(const double* p) {
+  Lanes r = { vld1q_f64(p), vld1q_f64(p + 2) };
+  return r;
+}
+
+inline Lanes widen(const int32_t* p) {
+  int32x4_t i = vld1q_s32(p);
+  Lanes r = { vcvtq_f64_s64(vmovl_s32(vget_low_s32(i))), vcvtq_f64_s64(vmovl_high_s32(i)) };
+  return r;
+}
+
+inline Lanes splat(double d) {
+  Lanes r = { vdupq_n_f64(d), vdupq_n_f64(d) };
+  return r;
+}
+
+inline Lanes operator+(Lanes a, Lanes b) {
+  Lanes r = { vaddq_f64(a.lo, b.lo), vaddq_f64(a.hi, b.hi) };
+  return r;
+}
+
+inline Lanes operator-(Lanes a, Lanes b) {
+  Lanes r = { vsubq_f64(a.lo, b.lo), vsubq_f64(a.hi, b.hi) };
+  return r;
+}
+
+inline Lanes operator*(Lanes a, Lanes b) {
+  Lanes r = { vmulq_f64(a.lo, b.lo), vmulq_f64(a.hi, b.hi) };
+  return r;
+}
+
+inline Lanes abs(Lanes a) {
+  Lanes r = { vabsq_f64(a.lo), vabsq_f64(a.hi) };
+  return r;
+}
+
+// Packs a comparison result, all ones or all zeros per lane, into a mask.
+inline unsigned lane_mask(uint64x2_t lo, uint64x2_t hi) {
+  return static_cast<unsigned>((vgetq_lane_u64(lo, 0) & 1)
+    | (vgetq_lane_u64(lo, 1) & 2)
+    | (vgetq_lane_u64(hi, 0) & 4)
+    | (vgetq_lane_u64(hi, 1) & 8));
+}
+
+inline unsigned greater(Lanes a, Lanes b) {
+  return lane_mask(vcgtq_f64(a.lo, b.lo), vcgtq_f64(a.hi, b.hi));
+}
+
+inline unsigned equal(Lanes a, Lanes b) {
+  return lane_mask(vceqq_f64(a.lo, b.lo), vceqq_f64(a.hi, b.hi));
+}
+#else
+struct Lanes {
+  double v[4];
+};
+
+template <typename T>
+inline Lanes widen(const T* p) {
+  Lanes r = { {
+    static_cast<double>(p[0]),
+    static_cast<double>(p[1]),
+    static_cast<double>(p[2]),
+    static_cast<double>(p[3]),
+  } };
+  return r;
+}
+
+inline Lanes splat(double d) {
+  Lanes r = { { d, d, d, d } };
+  return r;
+}
+
+inline Lanes operator+(Lanes a, Lanes b) {
+  for (int i = 0; i < 4; ++i) a.v[i] += b.v[i];
+  return a;
+}
+
+inline Lanes operator-(Lanes a, Lanes b) {
+  for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i];
+  return a;
+}
+
+inline Lanes operator*(Lanes a, Lanes b) {
+  for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i];
+  return a;
+}
+
+inline Lanes abs(Lanes a) {
+  for (int i = 0; i < 4; ++i) a.v[i] = std::fabs(a.v[i]);
+  return a;
+}
+
+inline unsigned greater(Lanes a, Lanes b) {
+  unsigned mask = 0;
+  for (int i = 0; i < 4; ++i) mask |= static_cast<unsigned>(a.v[i] > b.v[i]) << i;
+  return mask;
+}
+
+inline unsigned equal(Lanes a, Lanes b) {
+  unsigned mask = 0;
+  for (int i = 0; i < 4; ++i) mask |= static_cast<unsigned>(a.v[i] == b.v[i]) << i;
+  return mask;
+}
+#endif
+
+// Sorts the lanes by the sign of orient(a, b, c) where the filter settles
+// it. Both products are only zero when a factor is, so the determinant is
+// then exactly zero too. The rest need orient_exact.
+void orient_signs(const Lanes& ax,
+    const Lanes& ay,
+    const Lanes& bx,
+    const Lanes& by,
+    const Lanes& cx,
+    const Lanes& cy,
+    unsigned& positive,
+    unsigned& negative,
+    unsigned& zero) {
+  Lanes left = (ax - cx) * (by - cy);
+  Lanes right = (ay - cy) * (bx - cx);
+  Lanes det = left - right;
+  Lanes detsum = abs(left) + abs(right);
+  Lanes bound = splat(s_orient_bound) * detsum;
+  positive = greater(det, bound);
+  negative = greater(splat(0.0) - det, bound);
+  zero = equal(detsum, splat(0.0));
+}
+
+template <typename T>
+BasicPoint<T> corner(const T* x, const T* y, unsigned i) {
+  return BasicPoint<T>(x[i], y[i]);
+}
+
+template <typename T>
+unsigned in_triangle4(const BasicTriangles4<T>& tris, const T* x, const T* y, unsigned count) {
+  COUNT_N(m_orient, 3 * count);
+  unsigned lanes = (1u << count) - 1;
+  Lanes ax = widen(tris.ax), ay = widen(tris.ay);
+  Lanes bx = widen(tris.bx), by = widen(tris.by);
+  Lanes cx = widen(tris.cx), cy = widen(tris.cy);
+  Lanes px = widen(x), py = widen(y);
+
+  unsigned positive[3], negative[3], zero[3];
+  orient_signs(ax, ay, bx, by, px, py, positive[0], negative[0], zero[0]);
+  orient_signs(bx, by, cx, cy, px, py, positive[1], negative[1], zero[1]);
+  orient_signs(cx, cy, ax, ay, px, py, positive[2], negative[2], zero[2]);
+  for (int e = 0; e < 3; ++e) positive[e] |= zero[e];
+  unsigned in = positive[0] & positive[1] & positive[2] & lanes;
+  unsigned out = (negative[0] | negative[1] | negative[2]) & lanes;
+
+  for (unsigned unsure = lanes & ~(in | out); unsure; unsure &= unsure - 1) {
+    unsigned i = 0;
+    while (!((unsure >> i) & 1)) ++i;
+    BasicPoint<T> a = corner(tris.ax, tris.ay, i);
+    BasicPoint<T> b = corner(tris.bx, tris.by, i);
+    BasicPoint<T> c = corner(tris.cx, tris.cy, i);
+    BasicPoint<T> p = corner(x, y, i);
+    // Edges the filter settled as not negative keep that, only the others
+    // are recomputed.
+    bool inside = true;
+    for (int e = 0; e < 3 && inside; ++e) {
+      if ((positive[e] >> i) & 1) continue;
+      COUNT(m_orient_exact);
+      const BasicPoint<T>& u = e == 0 ? a : e == 1 ? b : c;
+      const BasicPoint<T>& v = e == 0 ? b : e == 1 ? c : a;
+      inside = orient_exact(u, v, p) >= 0;
+    }
+    if (inside) in |= 1u << i;
+  }
+  return in;
+}
+
+template <typename T>
+unsigned in_circle4(const BasicTriangles4<T>& tris, const T* x, const T* y, unsigned count) {
+  COUNT_N(m_incircle, count);
+  unsigned lanes = (1u << count) - 1;
+  Lanes dx = widen(x), dy = widen(y);
+  Lanes adx = widen(tris.ax) - dx, ady = widen(tris.ay) - dy;
+  Lanes bdx = widen(tris.bx) - dx, bdy = widen(tris.by) - dy;
+  Lanes cdx = widen(tris.cx) - dx, cdy = widen(tris.cy) - dy;
+
+  Lanes bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+  Lanes cdxady = cdx * ady, adxcdy = adx * cdy;
+  Lanes adxbdy = adx * bdy, bdxady = bdx * ady;
+  Lanes alift = adx * adx + ady * ady;
+  Lanes blift = bdx * bdx + bdy * bdy;
+  Lanes clift = cdx * cdx + cdy * cdy;
+
+  Lanes det = alift * (bdxcdy - cdxbdy)
+    + blift * (cdxady - adxcdy)
+    + clift * (adxbdy - bdxady);
+
+  Lanes permanent = (abs(bdxcdy) + abs(cdxbdy)) * alift
+    + (abs(cdxady) + abs(adxcdy)) * blift
+    + (abs(adxbdy) + abs(bdxady)) * clift;
+  Lanes bound = splat(s_incircle_bound) * permanent;
+  unsigned in = greater(det, bound) & lanes;
+  unsigned out = greater(splat(0.0) - det, bound) & lanes;
+
+  for (unsigned unsure = lanes & ~(in | out); unsure; unsure &= unsure - 1) {
+    unsigned i = 0;
+    while (!((unsure >> i) & 1)) ++i;
+    COUNT(m_incircle_exact);
+    if (incircle_exact(corner(tris.ax, tris.ay, i),
+        corner(tris.bx, tris.by, i),
+        corner(tris.cx, tris.cy, i),
+        corner(x, y, i)) > 0) {
+      in |= 1u << i;
+    }
+  }
+  return in;
+}
+
+template <typename T>
+unsigned ccw4(const BasicTriangles4<T>& tris, unsigned count) {
+  COUNT_N(m_orient, count);
+  unsigned lanes = (1u << count) - 1;
+  unsigned positive, negative, zero;
+  orient_signs(widen(tris.ax), widen(tris.ay),
+    widen(tris.bx), widen(tris.by),
+    widen(tris.cx), widen(tris.cy),
+    positive, negative, zero);
+  positive &= lanes;
+
+  for (unsigned unsure = lanes & ~(positive | negative | zero); unsure; unsure &= unsure - 1) {
+    unsigned i = 0;
+    while (!((unsure >> i) & 1)) ++i;
+    COUNT(m_orient_exact);
+    if (orient_exact(corner(tris.ax, tris.ay, i),
+        corner(tris.bx, tris.by, i),
+        corner(tris.cx, tris.cy, i)) > 0) {
+      positive |= 1u << i;
+    }
+  }
+  return positive;
+}
+
+template double orient(const BasicPoint<float>&, const BasicPoint<float>&, const BasicPoint<float>&);
+template double orient(const BasicPoint<double>&, const BasicPoint<double>&, const BasicPoint<double>&);
+template double incircle(const BasicPoint<float>&,
+  const BasicPoint<float>&,
+  const BasicPoint<float>&,
+  const BasicPoint<float>&);
+template double incircle(const BasicPoint<double>&,
+  const BasicPoint<double>&,
+  const BasicPoint<double>&,
+  const BasicPoint<double>&);
+#ifndef __SIZEOF_INT128__
+// Without 128 bit integers int32 points take the filtered path, which is
+// exact for them too.
+template double orient(const BasicPoint<int32_t>&, const BasicPoint<int32_t>&, const BasicPoint<int32_t>&);
+template double incircle(const BasicPoint<int32_t>&,
+  const BasicPoint<int32_t>&,
+  const BasicPoint<int32_t>&,
+  const BasicPoint<int32_t>&);
+#endif
+template unsigned in_triangle4(const BasicTriangles4<float>&, const float*, const float*, unsigned);
+template unsigned in_triangle4(const BasicTriangles4<double>&, const double*, const double*, unsigned);
+template unsigned in_triangle4(const BasicTriangles4<int32_t>&, const int32_t*, const int32_t*, unsigned);
+template unsigned in_circle4(const BasicTriangles4<float>&, const float*, const float*, unsigned);
+template unsigned in_circle4(const BasicTriangles4<double>&, const double*, const double*, unsigned);
+template unsigned in_circle4(const BasicTriangles4<int32_t>&, const int32_t*, const int32_t*, unsigned);
+template unsigned ccw4(const BasicTriangles4<float>&, unsigned);
+template unsigned ccw4(const BasicTriangles4<double>&, unsigned);
+template unsigned ccw4(const BasicTriangles4<int32_t>&, unsigned);
+
+}
@@ -0,0 +1,412 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace delaunay {
+
+static_assert(sizeof(SnapshotHeader) == 128, "The header is part of the file format.");
+static_assert(std::is_standard_layout<SnapshotHeader>::value, "The header is read in place.");
+
+const char s_snapshot_magic[8] = { 'D', 'E', 'L', 'A', 'U', 'N', 'A', 'Y' };
+const uint32_t s_snapshot_endian = 0x01020304u;
+
+template <typename T>
+struct ScalarKind;
+
+template <>
+struct ScalarKind<float> {
+  static const uint32_t value = 1;
+};
+
+template <>
+struct ScalarKind<double> {
+  static const uint32_t value = 2;
+};
+
+template <>
+struct ScalarKind<int32_t> {
+  static const uint32_t value = 3;
+};
+
+// Rounds offset up to where the next section can start.
+uint64_t align_section(uint64_t offset) {
+  return (offset + 63) & ~static_cast<uint64_t>(63);
+}
+
+template <typename T>
+double squared_distance(const BasicPoint<T>& a, const BasicPoint<T>& b) {
+  double dx = static_cast<double>(a.x) - b.x;
+  double dy = static_cast<double>(a.y) - b.y;
+  return dx * dx + dy * dy;
+}
+
+// Sequential output that remembers whether any write failed.
+class SnapshotFile {
+public:
+  explicit SnapshotFile(const char* path) : m_file(std::fopen(path, "wb")), m_offset(0), m_good(m_file != nullptr) {};
+
+  ~SnapshotFile() {
+    if (m_file) std::fclose(m_file);
+  };
+
+  void write(const void* data, size_t bytes) {
+    if (m_good && std::fwrite(data, 1, bytes, m_file) != bytes) m_good = false;
+    m_offset += bytes;
+  };
+
+  // Writes count values, fn(i) for each i, through a small buffer.
+  template <typename W, typename Fn>
+  void write_each(size_t count, Fn fn) {
+    W buffer[4096];
+    for (size_t i = 0; i < count; i += 4096) {
+      size_t n = std::min<size_t>(4096, count - i);
+      for (size_t k = 0; k < n; ++k) buffer[k] = fn(i + k);
+      write(buffer, n * sizeof(W));
+    }
+  };
+
+  // Pads with zeros up to offset.
+  void skip_to(uint64_t offset) {
+    static const char zeros[64] = {};
+    while (m_offset < offset) write(zeros, static_cast<size_t>(std::min<uint64_t>(64, offset - m_offset)));
+  };
+
+  bool close() {
+    bool closed = m_file && std::fclose(m_file) == 0;
+    m_file = nullptr;
+    return m_good && closed;
+  };
+
+private:
+  std::FILE* m_file;
+  uint64_t m_offset;
+  bool m_good;
+};
+
+template <typename Traits>
+bool write_snapshot(const BasicTriangulation<Traits>& tria, const char* path) {
+  typedef typename Traits::Scalar Scalar;
+  typedef typename BasicTriangulation<Traits>::TriNode TriNode;
+  const std::vector<TriNode*>& leaves = tria.m_leaves;
+
+  GridShape shape = tria.m_grid_shape;
+  std::vector<uint32_t> fresh;
+  const std::vector<uint32_t>* cells = &tria.m_grid;
+  if (cells->empty()) {
+    tria.build_grid(shape, fresh);
+    cells = &fresh;
+  }
+
+  SnapshotHeader header = SnapshotHeader();
+  std::memcpy(header.m_magic, s_snapshot_magic, sizeof(header.m_magic));
+  header.m_version = snapshot_version;
+  header.m_endian = s_snapshot_endian;
+  header.m_scalar = ScalarKind<Scalar>::value;
+  header.m_flags = tria.m_fixed.empty() ? 0 : snapshot_constrained;
+  header.m_vertex_count = static_cast<uint32_t>(tria.m_points.size());
+  header.m_triangle_count = static_cast<uint32_t>(leaves.size());
+  header.m_grid = shape;
+  uint64_t offset = align_section(sizeof(header));
+  header.m_points = offset;
+  offset = align_section(offset + tria.m_points.size() * sizeof(BasicPoint<Scalar>));
+  header.m_triangles = offset;
+  offset = align_section(offset + 3 * leaves.size() * sizeof(uint32_t));
+  header.m_neighbors = offset;
+  offset = align_section(offset + 3 * leaves.size() * sizeof(uint32_t));
+  header.m_incident = offset;
+  offset = align_section(offset + tria.m_points.size() * sizeof(uint32_t));
+  header.m_cells = offset;
+  offset += cells->size() * sizeof(uint32_t);
+  if (header.m_flags & snapshot_constrained) {
+    offset = align_section(offset);
+    header.m_constrained = offset;
+    offset += leaves.size();
+  }
+  header.m_size = offset;
+
+  SnapshotFile file(path);
+  file.write(&header, sizeof(header));
+  file.skip_to(header.m_points);
+  file.write(tria.m_points.data(), tria.m_points.size() * sizeof(BasicPoint<Scalar>));
+  file.skip_to(header.m_triangles);
+  file.write_each<uint32_t>(3 * leaves.size(), [&](size_t i) {
+    return leaves[i / 3]->m_ids[i % 3];
+  });
+  file.skip_to(header.m_neighbors);
+  file.write_each<uint32_t>(3 * leaves.size(), [&](size_t i) {
+    const TriNode* n = leaves[i / 3]->m_neighbors[i % 3];
+    return n->is_ghost() ? no_triangle : n->m_slot;
+  });
+  file.skip_to(header.m_incident);
+  file.write_each<uint32_t>(tria.m_points.size(), [&](size_t id) {
+    return tria.m_incident[id] ? tria.solid(static_cast<uint32_t>(id))->m_slot : no_triangle;
+  });
+  file.skip_to(header.m_cells);
+  file.write(cells->data(), cells->size() * sizeof(uint32_t));
+  if (header.m_flags & snapshot_constrained) {
+    file.skip_to(header.m_constrained);
+    file.write_each<uint8_t>(leaves.size(), [&](size_t t) {
+      const uint32_t* ids = leaves[t]->m_ids;
+      uint8_t flags = 0;
+      for (int i = 0; i < 3; ++i) {
+        if (tria.is_constrained(ids[i], ids[(i + 1) % 3])) flags |= 1 << i;
+      }
+      return flags;
+    });
+  }
+  return file.close();
+}
+
+template <typename T>
+BasicSnapshot<T>::BasicSnapshot() : m_map(nullptr),
+    m_map_size(0),
+    m_header(nullptr),
+    m_points(nullptr),
+    m_triangles(nullptr),
+    m_neighbors(nullptr),
+    m_incident(nullptr),
+    m_cells(nullptr),
+    m_constrained(nullptr) {
+}
+
+template <typename T>
+BasicSnapshot<T>::~BasicSnapshot() {
+  close();
+}
+
+template <typename T>
+bool BasicSnapshot<T>::open(const char* path) {
+  close();
+#ifdef _WIN32
+  std::FILE* file = std::fopen(path, "rb");
+  if (!file) return false;
+  bool read = std::fseek(file, 0, SEEK_END) == 0;
+  long size = read ? std::ftell(file) : -1;
+  read = size >= 0 && std::fseek(file, 0, SEEK_SET) == 0;
+  if (read) {
+    m_copy.resize((static_cast<size_t>(size) + 7) / 8);
+    read = std::fread(m_copy.data(), 1, static_cast<size_t>(size), file) == static_cast<size_t>(size);
+  }
+  std::fclose(file);
+  if (read && attach(reinterpret_cast<const unsigned char*>(m_copy.data()), static_cast<size_t>(size))) return true;
+  std::vector<uint64_t>().swap(m_copy);
+  return false;
+#else
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+    ::close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file open.
+  ::close(fd);
+  if (map == MAP_FAILED) return false;
+  if (!attach(static_cast<const unsigned char*>(map), size)) {
+    munmap(map, size);
+    return false;
+  }
+  m_map = map;
+  m_map_size = size;
+  return true;
+#endif
+}
+
+template <typename T>
+bool BasicSnapshot<T>::open(const void* data, size_t size) {
+  close();
+  return attach(static_cast<const unsigned char*>(data), size);
+}
+
+template <typename T>
+void BasicSnapshot<T>::close() {
+#ifndef _WIN32
+  if (m_map) munmap(m_map, m_map_size);
+#endif
+  m_map = nullptr;
+  m_map_size = 0;
+  std::vector<uint64_t>().swap(m_copy);
+  m_header = nullptr;
+  m_points = nullptr;
+  m_triangles = m_neighbors = m_incident = m_cells = nullptr;
+  m_constrained = nullptr;
+}
+
+template <typename T>
+bool BasicSnapshot<T>::attach(const unsigned char* data, size_t size) {
+  if (size < sizeof(SnapshotHeader) || reinterpret_cast<uintptr_t>(data) % 8) return false;
+  const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(data);
+  if (std::memcmp(header->m_magic, s_snapshot_magic, sizeof(header->m_magic))
+      || header->m_version != snapshot_version
+      || header->m_endian != s_snapshot_endian
+      || header->m_scalar != ScalarKind<T>::value
+      || header->m_size != size) {
+    return false;
+  }
+
+  // Each section has to start on the alignment and end inside the file.
+  auto fits = [&](uint64_t offset, uint64_t bytes) {
+    return offset % 64 == 0 && offset <= size && bytes <= size - offset;
+  };
+  uint64_t vertices = header->m_vertex_count;
+  uint64_t triangles = header->m_triangle_count;
+  uint64_t cells = static_cast<uint64_t>(header->m_grid.m_columns) * header->m_grid.m_rows;
+  bool constrained = (header->m_flags & snapshot_constrained) != 0;
+  if (!fits(header->m_points, vertices * sizeof(Point))
+      || !fits(header->m_triangles, 3 * triangles * sizeof(uint32_t))
+      || !fits(header->m_neighbors, 3 * triangles * sizeof(uint32_t))
+      || !fits(header->m_incident, vertices * sizeof(uint32_t))
+      || !fits(header->m_cells, cells * sizeof(uint32_t))
+      || (constrained && !fits(header->m_constrained, triangles))) {
+    return false;
+  }
+
+  m_header = header;
+  m_points = reinterpret_cast<const Point*>(data + header->m_points);
+  m_triangles = reinterpret_cast<const uint32_t*>(data + header->m_triangles);
+  m_neighbors = reinterpret_cast<const uint32_t*>(data + header->m_neighbors);
+  m_incident = reinterpret_cast<const uint32_t*>(data + header->m_incident);
+  m_cells = cells ? reinterpret_cast<const uint32_t*>(data + header->m_cells) : nullptr;
+  m_constrained = constrained ? data + header->m_constrained : nullptr;
+  return true;
+}
+
+template <typename T>
+bool BasicSnapshot<T>::is_open() const {
+  return m_header != nullptr;
+}
+
+template <typename T>
+size_t BasicSnapshot<T>::vertex_count() const {
+  return m_header ? m_header->m_vertex_count : 0;
+}
+
+template <typename T>
+size_t BasicSnapshot<T>::triangle_count() const {
+  return m_header ? m_header->m_triangle_count : 0;
+}
+
+template <typename T>
+const typename BasicSnapshot<T>::Point* BasicSnapshot<T>::vertices() const {
+  return m_points;
+}
+
+template <typename T>
+const uint32_t* BasicSnapshot<T>::indices() const {
+  return m_triangles;
+}
+
+template <typename T>
+const uint32_t* BasicSnapshot<T>::neighbors() const {
+  return m_neighbors;
+}
+
+template <typename T>
+bool BasicSnapshot<T>::is_constrained(uint32_t t, int edge) const {
+  return m_constrained && ((m_constrained[t] >> edge) & 1);
+}
+
+template <typename T>
+uint32_t BasicSnapshot<T>::start(const Point& pt) const {
+  if (m_cells) {
+    uint32_t id = m_cells[m_header->m_grid.cell(pt.x, pt.y)];
+    if (id != no_vertex && m_incident[id] != no_triangle) return m_incident[id];
+  }
+  return 0;
+}
+
+template <typename T>
+uint32_t BasicSnapshot<T>::find(const Point& pt) const {
+  if (!triangle_count()) return no_triangle;
+
+  uint32_t t = start(pt);
+  uint32_t previous = no_triangle;
+  uint32_t seed = 2463534242u;
+  for (;;) {
+    // As in the triangulation's walk, never step back and try the other
+    // edges in random order so a walk can't cycle.
+    seed = seed * 1664525u + 1013904223u;
+    int first = (seed >> 16) % 3;
+    const uint32_t* ids = m_triangles + 3 * t;
+    uint32_t next = t;
+    for (int i = 0; i < 3; ++i) {
+      int e = (first + i) % 3;
+      uint32_t n = m_neighbors[3 * t + e];
+      if (n != no_triangle && n == previous) continue;
+      if (orient(m_points[ids[e]], m_points[ids[(e + 1) % 3]], pt) < 0) {
+        next = n;
+        break;
+      }
+    }
+
+    // Beyond a hull edge is outside.
+    if (next == no_triangle || next == t) return next;
+    previous = t;
+    t = next;
+  }
+}
+
+template <typename T>
+uint32_t BasicSnapshot<T>::nearest(const Point& pt) const {
+  if (!triangle_count()) return no_vertex;
+
+  uint32_t best = no_vertex;
+  double d = 0;
+  const uint32_t* ids = m_triangles + 3 * start(pt);
+  for (int i = 0; i < 3; ++i) {
+    double e = squared_distance(pt, m_points[ids[i]]);
+    if (best == no_vertex || e < d) {
+      d = e;
+      best = ids[i];
+    }
+  }
+
+  // A vertex that isn't the closest always has a neighbor closer than it.
+  // Go around it one way, and the other way too if the hull cuts that off.
+  for (bool closer = true; closer;) {
+    closer = false;
+    uint32_t center = best;
+    uint32_t first = m_incident[center];
+    for (int side = 0; side < 2; ++side) {
+      uint32_t t = first;
+      do {
+        const uint32_t* tri = m_triangles + 3 * t;
+        int i = 0;
+        while (tri[i] != center) ++i;
+        uint32_t v = tri[side ? (i + 2) % 3 : (i + 1) % 3];
+        double e = squared_distance(pt, m_points[v]);
+        if (e < d) {
+          d = e;
+          best = v;
+          closer = true;
+        }
+        t = m_neighbors[3 * t + (side ? (i + 2) % 3 : i)];
+      } while (t != no_triangle && t != first);
+      if (t == first) break;
+    }
+  }
+  return best;
+}
+
+template bool write_snapshot(const Triangulation&, const char*);
+template bool write_snapshot(const DoubleTriangulation&, const char*);
+template bool write_snapshot(const BasicTriangulation<FastFloatTraits>&, const char*);
+template bool write_snapshot(const IntTriangulation&, const char*);
+
+template class BasicSnapshot<float>;
+template class BasicSnapshot<double>;
+template class BasicSnapshot<int32_t>;
+
+}
@@ -0,0 +1,464 @@
+#include "stream.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "predicates.h"
+
+namespace delaunay {
+
+// Triangles buffered before the sink gets them.
+const size_t s_stream_batch = 4096;
+
+// Center and radius of the circle through the triangle's points, grown a
+// little against rounding. Infinite for points on one line.
+template <typename T>
+void disk(const BasicPoint<T>* pts, double& x, double& y, double& r) {
+  double bx = static_cast<double>(pts[1].x) - pts[0].x;
+  double by = static_cast<double>(pts[1].y) - pts[0].y;
+  double cx = static_cast<double>(pts[2].x) - pts[0].x;
+  double cy = static_cast<double>(pts[2].y) - pts[0].y;
+  double b2 = bx * bx + by * by;
+  double c2 = cx * cx + cy * cy;
+  double d = 2 * (bx * cy - by * cx);
+  double ux = (cy * b2 - by * c2) / d;
+  double uy = (bx * c2 - cx * b2) / d;
+  x = pts[0].x + ux;
+  y = pts[0].y + uy;
+  r = std::sqrt(ux * ux + uy * uy) * (1 + 1e-6);
+}
+
+template <typename Traits>
+BasicStream<Traits>::BasicStream(const Point& min,
+    const Point& max,
+    uint32_t columns,
+    uint32_t rows,
+    Sink sink) : m_min(min),
+    m_max(max),
+    m_columns(std::max(columns, 1u)),
+    m_rows(std::max(rows, 1u)),
+    m_last(nullptr),
+    m_seed(2463534242u),
+    m_index(0),
+    m_dropped(0),
+    m_active(0),
+    m_peak(0),
+    m_sink(sink) {
+  double width = static_cast<double>(max.x) - min.x;
+  double height = static_cast<double>(max.y) - min.y;
+  m_scale_x = width > 0 ? m_columns / width : 0;
+  m_scale_y = height > 0 ? m_rows / height : 0;
+  m_finalized.assign(cell_count(), false);
+  m_waiting.assign(cell_count() + 1, nullptr);
+  m_out_ids.reserve(3 * s_stream_batch);
+  m_out_xy.reserve(6 * s_stream_batch);
+}
+
+template <typename Traits>
+size_t BasicStream<Traits>::cell(const Point& pt) const {
+  if (!(pt.x >= m_min.x && pt.x <= m_max.x && pt.y >= m_min.y && pt.y <= m_max.y)) return cell_count();
+  uint32_t x = std::min(static_cast<uint32_t>((static_cast<double>(pt.x) - m_min.x) * m_scale_x), m_columns - 1);
+  uint32_t y = std::min(static_cast<uint32_t>((static_cast<double>(pt.y) - m_min.y) * m_scale_y), m_rows - 1);
+  return static_cast<size_t>(y) * m_columns + x;
+}
+
+template <typename Traits>
+size_t BasicStream<Traits>::cell_count() const {
+  return static_cast<size_t>(m_columns) * m_rows;
+}
+
+template <typename Traits>
+void BasicStream<Traits>::expect(const uint64_t* counts) {
+  m_expected.assign(counts, counts + cell_count());
+  for (size_t c = 0; c < cell_count(); ++c) {
+    if (!m_expected[c]) finalize(c);
+  }
+}
+
+template <typename Traits>
+void BasicStream<Traits>::insert(const Scalar* xy, size_t count, size_t stride) {
+  for (size_t i = 0; i < count; ++i) add(point_at(xy, stride, i), m_index++);
+  flush();
+}
+
+template <typename Traits>
+void BasicStream<Traits>::add(const Point& pt, uint64_t index) {
+  size_t c = cell(pt);
+  if (c == cell_count() || m_finalized[c]) {
+    ++m_dropped;
+    return;
+  }
+
+  uint32_t id = add_vertex(pt, index);
+  if (!m_waiting.back()) {
+    // No triangle yet, every point so far is on one line.
+    bool duplicate = false;
+    for (uint32_t i : m_pending) duplicate = duplicate || equal(pt, m_vertices[i].m_pt);
+    if (duplicate) {
+      m_free.push_back(id);
+      ++m_dropped;
+    }
+    else {
+      m_pending.push_back(id);
+      flush_pending();
+    }
+  }
+  else if (!insert_cavity(id)) {
+    m_free.push_back(id);
+    ++m_dropped;
+  }
+
+  if (!m_expected.empty() && m_expected[c] && !--m_expected[c]) finalize(c);
+}
+
+template <typename Traits>
+uint32_t BasicStream<Traits>::add_vertex(const Point& pt, uint64_t index) {
+  Vertex v = { pt, index, 0 };
+  if (m_free.empty()) {
+    m_vertices.push_back(v);
+    return static_cast<uint32_t>(m_vertices.size() - 1);
+  }
+  uint32_t id = m_free.back();
+  m_free.pop_back();
+  m_vertices[id] = v;
+  return id;
+}
+
+template <typename Traits>
+void BasicStream<Traits>::flush_pending() {
+  size_t k = 2;
+  while (k < m_pending.size()
+      && Traits::Predicates::orient(m_vertices[m_pending[0]].m_pt,
+        m_vertices[m_pending[1]].m_pt,
+        m_vertices[m_pending[k]].m_pt) == 0) {
+    ++k;
+  }
+  if (k >= m_pending.size()) return;
+
+  start(m_pending[0], m_pending[1], m_pending[k]);
+  for (size_t i = 2; i < m_pending.size(); ++i) {
+    if (i == k) continue;
+    if (!insert_cavity(m_pending[i])) {
+      m_free.push_back(m_pending[i]);
+      ++m_dropped;
+    }
+  }
+  m_pending.clear();
+}
+
+template <typename Traits>
+void BasicStream<Traits>::start(uint32_t a, uint32_t b, uint32_t c) {
+  if (Traits::Predicates::orient(m_vertices[a].m_pt, m_vertices[b].m_pt, m_vertices[c].m_pt) < 0) std::swap(b, c);
+  StreamNode* node = make_node(a, b, c);
+  StreamNode* ghosts[3];
+  for (int i = 0; i < 3; ++i) {
+    ghosts[i] = make_node(node->m_ids[(i + 1) % 3], node->m_ids[i], infinite_vertex);
+  }
+  for (int i = 0; i < 3; ++i) {
+    node->m_neighbors[i] = ghosts[i];
+    ghosts[i]->m_neighbors[0] = node;
+    ghosts[i]->m_neighbors[1] = ghosts[(i + 2) % 3];
+    ghosts[i]->m_neighbors[2] = ghosts[(i + 1) % 3];
+  }
+  wait(node, 0);
+  for (StreamNode* ghost : ghosts) wait(ghost, 0);
+  m_last = node;
+}
+
+template <typename Traits>
+bool BasicStream<Traits>::equal(const Point& p1, const Point& p2) {
+  return std::fabs(static_cast<double>(p1.x) - p2.x) < Traits::tolerance()
+    && std::fabs(static_cast<double>(p1.y) - p2.y) < Traits::tolerance();
+}
+
+template <typename Traits>
+bool BasicStream<Traits>::conflicts(const StreamNode* node, const Point& pt) {
+  int g = 0;
+  while (g < 3 && node->m_ids[g] != infinite_vertex) ++g;
+  if (g == 3) return Traits::Predicates::incircle(node->m_pts[0], node->m_pts[1], node->m_pts[2], pt) > 0;
+
+  const Point& a = node->m_pts[(g + 1) % 3];
+  const Point& b = node->m_pts[(g + 2) % 3];
+  double o = Traits::Predicates::orient(a, b, pt);
+  if (o != 0) return o > 0;
+  if (a.x != b.x) return std::min(a.x, b.x) < pt.x && pt.x < std::max(a.x, b.x);
+  return std::min(a.y, b.y) < pt.y && pt.y < std::max(a.y, b.y);
+}
+
+template <typename Traits>
+typename BasicStream<Traits>::StreamNode* BasicStream<Traits>::locate(const Point& pt) {
+  // Sent triangles never hold a new point, their circumcircles only cover
+  // finalized cells, so the walk treats them as walls. Walls can still
+  // leave it with no way forward, then every live triangle is tried.
+  StreamNode* node = m_last;
+  StreamNode* previous = nullptr;
+  while (node) {
+    // Never step back, and try the other edges in random order so the walk
+    // can't cycle.
+    m_seed = m_seed * 1664525u + 1013904223u;
+    int first = (m_seed >> 16) % 3;
+    StreamNode* next = nullptr;
+    bool walled = false;
+    for (int i = 0; i < 3; ++i) {
+      int e = (first + i) % 3;
+      StreamNode* n = node->m_neighbors[e];
+      if (previous && n == previous) continue;
+      if (Traits::Predicates::orient(node->m_pts[e], node->m_pts[(e + 1) % 3], pt) < 0) {
+        if (n) {
+          next = n;
+          break;
+        }
+        walled = true;
+      }
+    }
+
+    if (!next) {
+      if (walled) break;
+      // pt is in node, only on its circumcircle if it is one of its
+      // vertices.
+      return conflicts(node, pt) ? node : nullptr;
+    }
+    if (next->is_ghost()) return next;
+    previous = node;
+    node = next;
+  }
+
+  for (StreamNode* head : m_waiting) {
+    for (StreamNode* n = head; n; n = n->m_next) {
+      if (conflicts(n, pt)) return n;
+    }
+  }
+  return nullptr;
+}
+
+template <typename Traits>
+bool BasicStream<Traits>::insert_cavity(uint32_t id) {
+  const Point pt = m_vertices[id].m_pt;
+  StreamNode* node = locate(pt);
+  if (!node) return false;
+
+  // The cavity is every triangle in memory whose circumcircle holds pt,
+  // sent ones never do.
+  m_cavity.clear();
+  m_cavity.push_back(node);
+  for (size_t i = 0; i < m_cavity.size(); ++i) {
+    StreamNode* t = m_cavity[i];
+    for (int e = 0; e < 3; ++e) {
+      StreamNode* n = t->m_neighbors[e];
+      if (!n || std::find(m_cavity.begin(), m_cavity.end(), n) != m_cavity.end()) continue;
+      if (conflicts(n, pt)) m_cavity.push_back(n);
+    }
+  }
+  for (StreamNode* t : m_cavity) {
+    for (int i = 0; i < 3; ++i) {
+      if (t->m_ids[i] != infinite_vertex && equal(pt, m_vertices[t->m_ids[i]].m_pt)) return false;
+    }
+  }
+
+  // Fan the boundary edges out from pt, across from whatever is beyond
+  // them, nothing for a sent triangle.
+  m_fan.clear();
+  for (StreamNode* t : m_cavity) {
+    for (int e = 0; e < 3; ++e) {
+      StreamNode* n = t->m_neighbors[e];
+      if (n && std::find(m_cavity.begin(), m_cavity.end(), n) != m_cavity.end()) continue;
+      StreamNode* f = make_node(id, t->m_ids[e], t->m_ids[(e + 1) % 3]);
+      f->m_neighbors[1] = n;
+      if (n) {
+        int j = 0;
+        while (n->m_neighbors[j] != t) ++j;
+        n->m_neighbors[j] = f;
+      }
+      m_fan.push_back(f);
+    }
+  }
+  for (StreamNode* f : m_fan) {
+    for (StreamNode* g : m_fan) {
+      if (f->m_ids[2] == g->m_ids[1]) {
+        f->m_neighbors[2] = g;
+        g->m_neighbors[0] = f;
+      }
+    }
+  }
+
+  for (StreamNode* t : m_cavity) release(t, false);
+  // pt's cell isn't finalized and every new circumcircle passes through
+  // pt, so none of them is final yet.
+  for (StreamNode* f : m_fan) {
+    wait(f, 0);
+    if (!f->is_ghost()) m_last = f;
+  }
+  return true;
+}
+
+template <typename Traits>
+typename BasicStream<Traits>::StreamNode* BasicStream<Traits>::make_node(uint32_t a, uint32_t b, uint32_t c) {
+  uint32_t ids[3] = { a, b, c };
+  Point pts[3];
+  for (int i = 0; i < 3; ++i) {
+    if (ids[i] == infinite_vertex) continue;
+    pts[i] = m_vertices[ids[i]].m_pt;
+    ++m_vertices[ids[i]].m_count;
+  }
+  StreamNode* node = m_nodes.create(pts[0], pts[1], pts[2]);
+  node->m_ids[0] = a;
+  node->m_ids[1] = b;
+  node->m_ids[2] = c;
+  m_peak = std::max(m_peak, ++m_active);
+  return node;
+}
+
+template <typename Traits>
+void BasicStream<Traits>::release(StreamNode* node, bool send) {
+  if (node->m_prev) node->m_prev->m_next = node->m_next;
+  else if (m_waiting[node->m_cell] == node) m_waiting[node->m_cell] = node->m_next;
+  if (node->m_next) node->m_next->m_prev = node->m_prev;
+
+  if (send) {
+    for (int i = 0; i < 3; ++i) {
+      const Vertex& v = m_vertices[node->m_ids[i]];
+      m_out_ids.push_back(v.m_index);
+      m_out_xy.push_back(v.m_pt.x);
+      m_out_xy.push_back(v.m_pt.y);
+    }
+    if (m_out_ids.size() >= 3 * s_stream_batch) flush();
+
+    // Whatever is left next to it has a wall there now.
+    for (int i = 0; i < 3; ++i) {
+      StreamNode* n = node->m_neighbors[i];
+      if (!n) continue;
+      int j = 0;
+      while (n->m_neighbors[j] != node) ++j;
+      n->m_neighbors[j] = nullptr;
+      if (m_last == node && !n->is_ghost()) m_last = n;
+    }
+    if (m_last == node) m_last = nullptr;
+  }
+
+  // A vertex goes with its last triangle. The cavity's are all in the fan
+  // made before it is released.
+  for (int i = 0; i < 3; ++i) {
+    if (node->m_ids[i] != infinite_vertex && !--m_vertices[node->m_ids[i]].m_count) m_free.push_back(node->m_ids[i]);
+  }
+  m_nodes.destroy(node);
+  --m_active;
+}
+
+template <typename Traits>
+void BasicStream<Traits>::wait(StreamNode* node, uint32_t from) {
+  uint32_t cell = static_cast<uint32_t>(cell_count());
+  if (!node->is_ghost()) {
+    double x, y, r;
+    disk(node->m_pts, x, y, r);
+    // The cells the circle's bounding box covers, the whole grid for a
+    // circle too big to compute. Cells outside the box never get points.
+    uint32_t x0 = 0, y0 = 0, x1 = m_columns - 1, y1 = m_rows - 1;
+    if (std::isfinite(r)) {
+      if (x + r < m_min.x || x - r > m_max.x || y + r < m_min.y || y - r > m_max.y) {
+        release(node, true);
+        return;
+      }
+      x0 = static_cast<uint32_t>(std::min(std::max((x - r - m_min.x) * m_scale_x, 0.0), m_columns - 1.0));
+      x1 = static_cast<uint32_t>(std::min(std::max((x + r - m_min.x) * m_scale_x, 0.0), m_columns - 1.0));
+      y0 = static_cast<uint32_t>(std::min(std::max((y - r - m_min.y) * m_scale_y, 0.0), m_rows - 1.0));
+      y1 = static_cast<uint32_t>(std::min(std::max((y + r - m_min.y) * m_scale_y, 0.0), m_rows - 1.0));
+    }
+
+    // Cells before from were finalized when the triangle last waited.
+    uint32_t row = from / m_columns;
+    for (uint32_t cy = std::max(y0, row); cy <= y1 && cell == cell_count(); ++cy) {
+      uint32_t cx = cy == row ? std::max(x0, from % m_columns) : x0;
+      for (; cx <= x1; ++cx) {
+        if (!m_finalized[cy * m_columns + cx]) {
+          cell = cy * m_columns + cx;
+          break;
+        }
+      }
+    }
+    if (cell == cell_count()) {
+      release(node, true);
+      return;
+    }
+  }
+
+  node->m_cell = cell;
+  node->m_prev = nullptr;
+  node->m_next = m_waiting[cell];
+  if (node->m_next) node->m_next->m_prev = node;
+  m_waiting[cell] = node;
+}
+
+template <typename Traits>
+void BasicStream<Traits>::finalize(size_t cell) {
+  if (cell >= cell_count() || m_finalized[cell]) return;
+  m_finalized[cell] = true;
+
+  StreamNode* node = m_waiting[cell];
+  m_waiting[cell] = nullptr;
+  while (node) {
+    StreamNode* next = node->m_next;
+    node->m_prev = node->m_next = nullptr;
+    wait(node, static_cast<uint32_t>(cell));
+    node = next;
+  }
+  flush();
+}
+
+template <typename Traits>
+void BasicStream<Traits>::finish() {
+  for (size_t c = 0; c < cell_count(); ++c) finalize(c);
+  while (StreamNode* ghost = m_waiting.back()) release(ghost, false);
+  flush();
+  m_nodes.clear();
+  std::vector<Vertex>().swap(m_vertices);
+  std::vector<uint32_t>().swap(m_free);
+  m_pending.clear();
+  m_last = nullptr;
+}
+
+template <typename Traits>
+void BasicStream<Traits>::run(const Reader& read, size_t chunk) {
+  std::vector<Scalar> xy(2 * chunk);
+  for (size_t count; (count = read(xy.data(), chunk)) > 0;) insert(xy.data(), count, 2 * sizeof(Scalar));
+  finish();
+}
+
+template <typename Traits>
+void BasicStream<Traits>::flush() {
+  if (m_out_ids.empty()) return;
+  m_sink(m_out_ids.data(), m_out_xy.data(), m_out_ids.size() / 3);
+  m_out_ids.clear();
+  m_out_xy.clear();
+}
+
+template <typename Traits>
+size_t BasicStream<Traits>::dropped() const {
+  return m_dropped;
+}
+
+template <typename Traits>
+size_t BasicStream<Traits>::active_triangles() const {
+  return m_active;
+}
+
+template <typename Traits>
+size_t BasicStream<Traits>::peak_triangles() const {
+  return m_peak;
+}
+
+template <typename Traits>
+size_t BasicStream<Traits>::bytes() const {
+  return m_nodes.bytes()
+    + m_vertices.capacity() * sizeof(Vertex)
+    + m_free.capacity() * sizeof(uint32_t)
+    + m_finalized.size() / 8
+    + m_expected.capacity() * sizeof(uint64_t)
+    + m_waiting.capacity() * sizeof(StreamNode*);
+}
+
+template class BasicStream<FloatTraits>;
+template class BasicStream<DoubleTraits>;
+template class BasicStream<FastFloatTraits>;
+template class BasicStream<IntTraits>;
+
+}
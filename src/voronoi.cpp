@@ -0,0 +1,162 @@
+#include "voronoi.h"
+
+#include <algorithm>
+
+#include "parallel.h"
+
+namespace delaunay {
+
+// A cell corner, kept in double precision while the cell is clipped.
+struct Corner {
+  double x;
+  double y;
+};
+
+// Writes the part of polygon where a * x + b * y <= c to out.
+void clip(const std::vector<Corner>& polygon, double a, double b, double c, std::vector<Corner>& out) {
+  out.clear();
+  size_t n = polygon.size();
+  for (size_t i = 0; i < n; ++i) {
+    const Corner& p = polygon[i];
+    const Corner& q = polygon[(i + 1) % n];
+    double dp = a * p.x + b * p.y - c;
+    double dq = a * q.x + b * q.y - c;
+    if (dp <= 0) out.push_back(p);
+    if ((dp < 0 && dq > 0) || (dp > 0 && dq < 0)) {
+      double t = dp / (dp - dq);
+      Corner r = { p.x + t * (q.x - p.x), p.y + t * (q.y - p.y) };
+      out.push_back(r);
+    }
+  }
+}
+
+template <typename T>
+bool inside(const Corner& p, const BasicPoint<T>& min, const BasicPoint<T>& max) {
+  return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y;
+}
+
+template <typename Traits>
+void voronoi(const BasicTriangulation<Traits>& tria,
+    const BasicPoint<typename Traits::Scalar>& min,
+    const BasicPoint<typename Traits::Scalar>& max,
+    unsigned threads,
+    BasicVoronoi<typename Traits::Scalar>& out) {
+  typedef typename Traits::Scalar Scalar;
+  typedef typename BasicTriangulation<Traits>::Point Point;
+  typedef typename BasicTriangulation<Traits>::TriNode TriNode;
+  const std::vector<TriNode*>& leaves = tria.m_leaves;
+  out.m_center_x.resize(leaves.size());
+  out.m_center_y.resize(leaves.size());
+  parallel_for(leaves.size(), threads, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; ++i) {
+      const TriNode* node = leaves[i];
+      Point c = circumcenter(node->m_pts[0], node->m_pts[1], node->m_pts[2]);
+      out.m_center_x[i] = c.x;
+      out.m_center_y[i] = c.y;
+    }
+  });
+
+  // Each thread writes the cells of its range of vertices to arrays of its
+  // own, which are copied into place once every cell's size is known.
+  size_t count = tria.m_points.size();
+  out.m_offsets.assign(count + 1, 0);
+  std::vector<std::vector<Scalar>> xs(thread_count(threads));
+  std::vector<std::vector<Scalar>> ys(xs.size());
+  parallel_for(count, threads, [&](size_t begin, size_t end, unsigned thread) {
+    std::vector<Corner> cell;
+    std::vector<Corner> scratch;
+    // Cells have six corners on average.
+    xs[thread].reserve(6 * (end - begin));
+    ys[thread].reserve(6 * (end - begin));
+    for (size_t id = begin; id < end; ++id) {
+      const TriNode* first = tria.m_incident[id];
+      if (!first) continue;
+
+      cell.clear();
+      bool hull = false;
+      bool clipped = false;
+      const TriNode* t = first;
+      do {
+        int i = 0;
+        while (t->m_ids[i] != id) ++i;
+        if (t->is_ghost()) {
+          hull = true;
+        }
+        else {
+          Corner c = { out.m_center_x[t->m_slot], out.m_center_y[t->m_slot] };
+          clipped = clipped || !inside(c, min, max);
+          cell.push_back(c);
+        }
+        t = t->m_neighbors[(i + 2) % 3];
+      } while (t != first);
+
+      if (hull) {
+        // Unbounded, so start from the box and keep the side of the
+        // bisector with each neighbor closer to id.
+        const Point& p = tria.m_points[id];
+        cell.clear();
+        Corner box[4] = { { min.x, min.y }, { max.x, min.y }, { max.x, max.y }, { min.x, max.y } };
+        cell.assign(box, box + 4);
+        do {
+          int i = 0;
+          while (t->m_ids[i] != id) ++i;
+          uint32_t v = t->m_ids[(i + 1) % 3];
+          if (v != infinite_vertex) {
+            const Point& q = tria.m_points[v];
+            double a = static_cast<double>(q.x) - p.x;
+            double b = static_cast<double>(q.y) - p.y;
+            double c = 0.5 * (a * (static_cast<double>(q.x) + p.x) + b * (static_cast<double>(q.y) + p.y));
+            clip(cell, a, b, c, scratch);
+            cell.swap(scratch);
+          }
+          t = t->m_neighbors[(i + 2) % 3];
+        } while (t != first);
+      }
+      else if (clipped) {
+        clip(cell, -1, 0, -min.x, scratch);
+        clip(scratch, 1, 0, max.x, cell);
+        clip(cell, 0, -1, -min.y, scratch);
+        clip(scratch, 0, 1, max.y, cell);
+      }
+
+      // Cocircular points give several triangles the same circumcenter.
+      std::vector<Scalar>& x = xs[thread];
+      std::vector<Scalar>& y = ys[thread];
+      size_t start = x.size();
+      for (const Corner& c : cell) {
+        Scalar cx = static_cast<Scalar>(c.x);
+        Scalar cy = static_cast<Scalar>(c.y);
+        if (x.size() > start && x.back() == cx && y.back() == cy) continue;
+        x.push_back(cx);
+        y.push_back(cy);
+      }
+      while (x.size() > start + 1 && x.back() == x[start] && y.back() == y[start]) {
+        x.pop_back();
+        y.pop_back();
+      }
+      out.m_offsets[id + 1] = static_cast<uint32_t>(x.size() - start);
+    }
+  });
+
+  for (size_t id = 0; id < count; ++id) out.m_offsets[id + 1] += out.m_offsets[id];
+  out.m_x.resize(out.m_offsets[count]);
+  out.m_y.resize(out.m_offsets[count]);
+  parallel_for(count, threads, [&](size_t begin, size_t, unsigned thread) {
+    std::copy(xs[thread].begin(), xs[thread].end(), out.m_x.begin() + out.m_offsets[begin]);
+    std::copy(ys[thread].begin(), ys[thread].end(), out.m_y.begin() + out.m_offsets[begin]);
+  });
+}
+
+template void voronoi<FloatTraits>(const Triangulation&, const Point&, const Point&, unsigned, Voronoi&);
+template void voronoi<DoubleTraits>(const DoubleTriangulation&,
+  const DoublePoint&,
+  const DoublePoint&,
+  unsigned,
+  BasicVoronoi<double>&);
+template void voronoi<FastFloatTraits>(const BasicTriangulation<FastFloatTraits>&,
+  const Point&,
+  const Point&,
+  unsigned,
+  Voronoi&);
+
+}
@@ -0,0 +1,100 @@
+#include "weld.h"
+
+#include <cmath>
+
+namespace delaunay {
+
+uint64_t cell_hash(int64_t x, int64_t y) {
+  uint64_t h = static_cast<uint64_t>(x) * 0x9e3779b97f4a7c15ull
+    ^ static_cast<uint64_t>(y) * 0xc2b2ae3d27d4eb4full;
+  return h ^ (h >> 32);
+}
+
+// Open addressing table from grid cells to the kept points in them, at
+// most half full.
+class CellTable {
+public:
+  explicit CellTable(size_t count) : m_mask(15) {
+    while (m_mask + 1 < 2 * count) m_mask = 2 * m_mask + 1;
+    m_x.resize(m_mask + 1);
+    m_y.resize(m_mask + 1);
+    m_heads.assign(m_mask + 1, no_vertex);
+  }
+
+  // Slot of cell x, y, empty if it holds no point yet.
+  size_t slot(int64_t x, int64_t y) const {
+    size_t s = cell_hash(x, y) & m_mask;
+    while (m_heads[s] != no_vertex && (m_x[s] != x || m_y[s] != y)) s = (s + 1) & m_mask;
+    return s;
+  }
+
+  // First point in slot s, the rest follow through the next links.
+  uint32_t head(size_t s) const {
+    return m_heads[s];
+  }
+
+  void push(size_t s, int64_t x, int64_t y, uint32_t point, std::vector<uint32_t>& next) {
+    m_x[s] = x;
+    m_y[s] = y;
+    next[point] = m_heads[s];
+    m_heads[s] = point;
+  }
+
+private:
+  size_t m_mask;
+  std::vector<int64_t> m_x;
+  std::vector<int64_t> m_y;
+  std::vector<uint32_t> m_heads;
+};
+
+template <typename T>
+size_t weld(const T* xy,
+    size_t count,
+    size_t stride,
+    double tolerance,
+    std::vector<uint32_t>& remap) {
+  remap.resize(count);
+  CellTable table(count);
+  std::vector<uint32_t> next(count);
+  double inverse = 0.5 / tolerance;
+  size_t kept = 0;
+  for (size_t i = 0; i < count; ++i) {
+    BasicPoint<T> p = point_at(xy, stride, i);
+    double fx = std::floor(p.x * inverse);
+    double fy = std::floor(p.y * inverse);
+    int64_t cx = static_cast<int64_t>(fx);
+    int64_t cy = static_cast<int64_t>(fy);
+    // Anything close enough is in this cell or the one on the nearer side
+    // along each axis.
+    int64_t xs[2] = { cx, p.x * inverse - fx < 0.5 ? cx - 1 : cx + 1 };
+    int64_t ys[2] = { cy, p.y * inverse - fy < 0.5 ? cy - 1 : cy + 1 };
+
+    // The earliest such point, so the result doesn't depend on the hash.
+    uint32_t found = no_vertex;
+    for (int k = 0; k < 4; ++k) {
+      for (uint32_t j = table.head(table.slot(xs[k & 1], ys[k >> 1])); j != no_vertex; j = next[j]) {
+        BasicPoint<T> q = point_at(xy, stride, j);
+        if (j < found
+            && std::fabs(static_cast<double>(q.x) - p.x) < tolerance
+            && std::fabs(static_cast<double>(q.y) - p.y) < tolerance) {
+          found = j;
+        }
+      }
+    }
+
+    if (found != no_vertex) {
+      remap[i] = found;
+      continue;
+    }
+    remap[i] = static_cast<uint32_t>(i);
+    table.push(table.slot(cx, cy), cx, cy, static_cast<uint32_t>(i), next);
+    ++kept;
+  }
+  return kept;
+}
+
+template size_t weld(const float*, size_t, size_t, double, std::vector<uint32_t>&);
+template size_t weld(const double*, size_t, size_t, double, std::vector<uint32_t>&);
+template size_t weld(const int32_t*, size_t, size_t, double, std::vector<uint32_t>&);
+
+}